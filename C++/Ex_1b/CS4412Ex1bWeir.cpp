@@ -1,6 +1,15 @@
 # include <iostream>
 #include <chrono>
 #include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
 
 
 using namespace std;
@@ -33,7 +42,123 @@ void minMax(uint32_t* list, size_t size, int min, int max){
     //cout << "\n Min: " << min << "\n Max: " << max;
 }
 
-void fooSort(uint32_t* list, size_t size){
+// How fooSort gets the memory for its 2^32 counters
+enum class FreqAllocMode {
+    Eager,        // new[]() and zero-fill all 16 GB up front (the original version)
+    LazyHugePage  // mmap with MAP_NORESERVE + huge pages, only the pages the data touches get used
+};
+
+/**
+ * @class LazyFreqCount
+ * @details The freqCount array for the full range of uint32_t, but the memory is only reserved and not zeroed.
+ * The OS hands out zero pages the first time they are written, so the cost follows the data and not 2^32.
+ * A bitmap with one bit per block of counters remembers which blocks were touched, so the
+ * reconstruction pass can skip the blocks that are still all zero.
+ */
+class LazyFreqCount {
+private:
+    static const size_t countSize = 1ULL << 32;
+    static const size_t blockShift = 10; // 1024 counters = one 4 KB page per block
+    static const size_t blockCount = countSize >> blockShift;
+
+    uint32_t* counts;
+    uint64_t* touched; // blockCount bits, 512 KB
+    bool mapped;
+
+public:
+    LazyFreqCount() : counts(nullptr), touched(new uint64_t[blockCount / 64]()), mapped(false) {
+        const size_t bytes = countSize * sizeof(uint32_t);
+#if defined(__unix__) || defined(__APPLE__)
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            // Transparent huge pages, fewer page faults and TLB misses when the values are spread out
+            madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+            counts = static_cast<uint32_t*>(memory);
+            mapped = true;
+        }
+#endif
+        if (!mapped) {
+            // calloc of a block this size is also lazily zeroed by most operating systems
+            counts = static_cast<uint32_t*>(calloc(countSize, sizeof(uint32_t)));
+        }
+        if (counts == nullptr) {
+            delete[] touched;
+            throw bad_alloc();
+        }
+    }
+
+    ~LazyFreqCount() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped) {
+            munmap(counts, countSize * sizeof(uint32_t));
+        }
+#endif
+        if (!mapped) {
+            free(counts);
+        }
+        delete[] touched;
+    }
+
+    LazyFreqCount(const LazyFreqCount&) = delete;
+    LazyFreqCount& operator=(const LazyFreqCount&) = delete;
+
+    void increment(uint32_t e) {
+        size_t block = e >> blockShift;
+        touched[block / 64] |= 1ULL << (block % 64);
+        counts[e]++;
+    }
+
+    /**
+     * Writes the values back out in sorted order, only visiting the blocks that were touched
+     * @param a - The output array, must have room for every value that was counted
+     * @return The number of values written
+     */
+    size_t reconstruct(uint32_t* a) {
+        size_t position = 0;
+        for (size_t word = 0; word < blockCount / 64; word++) {
+            uint64_t bits = touched[word];
+            while (bits != 0) {
+                size_t block = word * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                size_t first = block << blockShift;
+                size_t last = first + (1ULL << blockShift);
+                for (size_t i = first; i < last; i++) {
+                    while (counts[i] > 0) {
+                        a[position] = i;
+                        position++;
+                        counts[i]--;
+                    }
+                }
+            }
+        }
+        return position;
+    }
+};
+
+void fooSort(uint32_t* list, size_t size, FreqAllocMode mode = FreqAllocMode::Eager){
+
+    if (mode == FreqAllocMode::LazyHugePage) {
+        LazyFreqCount lazyCount;
+        for (size_t i = 0; i < size; ++i) {
+            lazyCount.increment(list[i]);
+        }
+
+        uint32_t* a = new uint32_t[size]; // sorted array
+        lazyCount.reconstruct(a);
+
+        // Print Sorted
+        cout << "Sorted: "<< endl;
+        for(size_t p = 0; p<size; ++p){
+            cout << a[p] << " ";
+        }
+        cout <<"\n\n";
+
+        delete[] a;
+        return;
+    }
 
     // Allocate a freqCount array of length 2^32-1, and initialize the entire array to zero
     const size_t freqCountSize = 1ULL << 32; // 2^32-1,
@@ -110,6 +235,310 @@ void fooSortAlt(uint32_t* list, size_t size){
     delete[] a;
 }
 
+/**
+ * @class FrequencyIndex
+ * @details Keeps the frequency table from the counting pass instead of throwing it away, so the same data can be asked
+ * count, rank, k-th smallest, percentile and distinct count questions without sorting again.
+ * Like fooSortAlt the counters only cover the range min..max of the values.
+ *  - prefix[v - min] is the number of values smaller than v, so count and rank are O(1)
+ *  - The counts are also written in unary into a bitvector (count ones then a zero for every value in the range).
+ *    The k-th one sits after exactly (value - min) zeros, so k-th smallest is a select on that bitvector.
+ *    Every selectSample-th one has its word saved, so a select is a sample lookup plus a short popcount scan.
+ *  - A Fenwick tree (binary indexed tree) over the counts is patched by add() and remove() in O(log range).
+ * An update leaves the prefix sums and the bitvector stale. Until they are rebuilt rank is a prefix sum on the Fenwick
+ * tree and select walks down it, both O(log range), and they are rebuilt lazily once rebuildAfter queries in a row have
+ * been asked with no update in between. So a read-mostly index is back to O(1) rank soon after its last update.
+ */
+class FrequencyIndex {
+private:
+    static const uint64_t selectSample = 512;
+    static const uint64_t rebuildAfter = 1024;
+
+    // Word holding a sampled one, and how many ones come before that word
+    struct SelectHint {
+        size_t word;
+        uint64_t onesBefore;
+    };
+
+    uint32_t minValue;
+    vector<uint32_t> counts;
+    vector<uint64_t> tree;  // Fenwick tree, counts.size() + 1 entries, tree[0] unused
+    uint64_t total;
+    size_t distinct;
+
+    // The static rank and select structures, a cache rebuilt by the queries
+    mutable vector<uint64_t> prefix;  // counts.size() + 1 entries
+    mutable vector<uint64_t> unary;   // total + counts.size() bits
+    mutable vector<SelectHint> hints; // one per selectSample ones
+    mutable bool stale;
+    mutable uint64_t staleQueries;    // queries answered from the tree since the last update
+
+    // Grow the counter range so that it covers value, the tree is built again over the new range
+    void cover(uint32_t value) {
+        if (counts.empty()) {
+            minValue = value;
+            counts.assign(1, 0);
+        } else if (value < minValue) {
+            counts.insert(counts.begin(), minValue - value, 0);
+            minValue = value;
+        } else if (value - minValue >= counts.size()) {
+            counts.resize(size_t(value - minValue) + 1, 0);
+        } else {
+            return;
+        }
+        buildTree();
+    }
+
+    // Builds the Fenwick tree from counts in one linear pass
+    void buildTree() {
+        tree.assign(counts.size() + 1, 0);
+        for (size_t i = 1; i < tree.size(); i++) {
+            tree[i] += counts[i - 1];
+            size_t parent = i + (i & (0 - i));
+            if (parent < tree.size()) {
+                tree[parent] += tree[i];
+            }
+        }
+    }
+
+    // Adds delta to the count at position (value - min)
+    void updateTree(size_t position, int64_t delta) {
+        for (size_t i = position + 1; i < tree.size(); i += i & (0 - i)) {
+            tree[i] += uint64_t(delta);
+        }
+    }
+
+    // Sum of the counts before position
+    uint64_t prefixSum(size_t position) const {
+        uint64_t sum = 0;
+        for (size_t i = position; i > 0; i -= i & (0 - i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    // The k-th smallest by walking down the tree, taking every subtree whose values all come before it
+    uint32_t selectFromTree(uint64_t k) const {
+        size_t position = 0;
+        size_t step = 1;
+        while (step * 2 < tree.size()) {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2) {
+            if (position + step < tree.size() && tree[position + step] <= k) {
+                position += step;
+                k -= tree[position];
+            }
+        }
+        return minValue + uint32_t(position);
+    }
+
+    void rebuildStatic() const {
+        prefix.assign(counts.size() + 1, 0);
+        unary.assign((total + counts.size() + 63) / 64, 0);
+        hints.clear();
+
+        uint64_t bit = 0;
+        uint64_t ones = 0;
+        uint64_t onesBeforeWord = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            prefix[i + 1] = prefix[i] + counts[i];
+            for (uint32_t c = 0; c < counts[i]; c++) {
+                if (bit % 64 == 0) {
+                    onesBeforeWord = ones;
+                }
+                if (ones % selectSample == 0) {
+                    hints.push_back({size_t(bit / 64), onesBeforeWord});
+                }
+                unary[bit / 64] |= 1ULL << (bit % 64);
+                bit++;
+                ones++;
+            }
+            // The zero closing this value
+            if (bit % 64 == 0) {
+                onesBeforeWord = ones;
+            }
+            bit++;
+        }
+        stale = false;
+    }
+
+    // True if the query has to go to the Fenwick tree, rebuilds the static structures once enough queries came in a row
+    bool useTree() const {
+        if (!stale) {
+            return false;
+        }
+        if (++staleQueries < rebuildAfter) {
+            return true;
+        }
+        rebuildStatic();
+        return false;
+    }
+
+    void changed() {
+        stale = true;
+        staleQueries = 0;
+    }
+
+public:
+    FrequencyIndex() : minValue(0), total(0), distinct(0), stale(false), staleQueries(0) {}
+
+    /**
+     * Builds the index with one counting pass over the list
+     * @param list - The values to index
+     * @param size - Number of values in list
+     */
+    FrequencyIndex(const uint32_t* list, size_t size) : FrequencyIndex() {
+        if (size == 0) {
+            return;
+        }
+        uint32_t min = list[0], max = list[0];
+        for (size_t i = 1; i < size; ++i) {
+            if (list[i] > max) max = list[i];
+            if (list[i] < min) min = list[i];
+        }
+        minValue = min;
+        counts.assign(size_t(max - min) + 1, 0);
+        for (size_t i = 0; i < size; ++i) {
+            if (counts[list[i] - min]++ == 0) {
+                distinct++;
+            }
+        }
+        total = size;
+        buildTree();
+        rebuildStatic();
+    }
+
+    // Incremental updates, O(log range) unless the range has to grow
+    void add(uint32_t value) {
+        cover(value);
+        if (counts[value - minValue]++ == 0) {
+            distinct++;
+        }
+        updateTree(value - minValue, 1);
+        total++;
+        changed();
+    }
+    // Returns false if value was not in the index
+    bool remove(uint32_t value) {
+        if (count(value) == 0) {
+            return false;
+        }
+        if (--counts[value - minValue] == 0) {
+            distinct--;
+        }
+        updateTree(value - minValue, -1);
+        total--;
+        changed();
+        return true;
+    }
+
+    // Queries
+    uint64_t size() const { return total; }
+    size_t distinctCount() const { return distinct; }
+
+    uint32_t count(uint32_t value) const {
+        if (counts.empty() || value < minValue || value - minValue >= counts.size()) {
+            return 0;
+        }
+        return counts[value - minValue];
+    }
+
+    // Number of values strictly smaller than value
+    uint64_t rank(uint32_t value) const {
+        if (counts.empty() || value < minValue) {
+            return 0;
+        }
+        if (value - minValue >= counts.size()) {
+            return total;
+        }
+        return useTree() ? prefixSum(value - minValue) : prefix[value - minValue];
+    }
+
+    /**
+     * The k-th smallest value, counting from 0 like an index into the sorted list
+     * @param k - Position in the sorted order, must be less than size()
+     */
+    uint32_t kthSmallest(uint64_t k) const {
+        if (k >= total) {
+            throw out_of_range("FrequencyIndex::kthSmallest past the end");
+        }
+        if (useTree()) {
+            return selectFromTree(k);
+        }
+
+        // Start at the sampled word, then popcount forward to the word holding the k-th one
+        const SelectHint& hint = hints[k / selectSample];
+        size_t word = hint.word;
+        uint64_t onesBefore = hint.onesBefore;
+        uint64_t ones = __builtin_popcountll(unary[word]);
+        while (onesBefore + ones <= k) {
+            onesBefore += ones;
+            word++;
+            ones = __builtin_popcountll(unary[word]);
+        }
+
+        // Drop the ones in front of it inside the word
+        uint64_t bits = unary[word];
+        for (uint64_t skip = k - onesBefore; skip > 0; skip--) {
+            bits &= bits - 1;
+        }
+        uint64_t position = word * 64 + __builtin_ctzll(bits);
+
+        // Every zero before the k-th one closed a smaller value
+        return minValue + uint32_t(position - k);
+    }
+
+    /**
+     * Nearest-rank percentile
+     * @param percent - Between 0 and 100
+     */
+    uint32_t percentile(double percent) const {
+        if (total == 0) {
+            throw out_of_range("FrequencyIndex::percentile of an empty index");
+        }
+        double position = percent / 100.0 * double(total);
+        uint64_t k = position <= 1.0 ? 0 : uint64_t(ceil(position)) - 1;
+        return kthSmallest(k < total ? k : total - 1);
+    }
+
+    /**
+     * Writes the values out in sorted order, the same reconstruction pass as fooSort
+     * @param a - Output array with room for size() values
+     */
+    void writeSorted(uint32_t* a) const {
+        size_t position = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            for (uint32_t c = 0; c < counts[i]; c++) {
+                a[position++] = minValue + uint32_t(i);
+            }
+        }
+    }
+};
+
+/**
+ * Same as fooSortAlt but keeps the frequency table around as a FrequencyIndex for later queries
+ * @param list - Array to sort
+ * @param size - Size of the array
+ * @return The index built by the counting pass
+ */
+FrequencyIndex fooSortIndexed(uint32_t* list, size_t size){
+    FrequencyIndex index(list, size);
+
+    uint32_t* a = new uint32_t[size]; // sorted array
+    index.writeSorted(a);
+
+    // Print Sorted
+    cout << "Sorted: "<< endl;
+    for(size_t p = 0; p<size; ++p){
+        cout << a[p] << " ";
+    }
+    cout <<"\n\n";
+
+    delete[] a;
+    return index;
+}
+
 void fooSortVectors(vector<uint32_t> list){
     // Get max and min
     uint32_t max, min;
@@ -171,9 +600,11 @@ int main(){
     // Measure time using chrono before running it
     auto start_time = chrono::high_resolution_clock::now();
 
-    fooSort(list, listSize);
+    fooSort(list, listSize, FreqAllocMode::LazyHugePage);
+    //fooSort(list, listSize);
     //fooSortAlt(list, listSize);
     //fooSortVectors(vector1);
+    //FrequencyIndex index = fooSortIndexed(list, listSize);
 
    //test minMax
 //    int min, max;
@@ -186,6 +617,17 @@ int main(){
     chrono::duration<double, milli> elapsed_time = end_time - start_time;
     cout << "Sorting time for a: " << elapsed_time.count() << " milliseconds\n\n";
 
+    // Reuse one counting pass for repeated queries instead of sorting again
+    FrequencyIndex index(list, listSize);
+    cout << "Distinct values: " << index.distinctCount() << "\n";
+    cout << "Count of 42: " << index.count(42) << ", rank of 42: " << index.rank(42) << "\n";
+    cout << "Median: " << index.percentile(50) << ", 90th percentile: " << index.percentile(90)
+         << ", 99th percentile: " << index.percentile(99) << "\n";
+    index.add(1000);
+    index.remove(0);
+    cout << "After adding 1000 and removing a 0, max: " << index.kthSmallest(index.size() - 1)
+         << ", min: " << index.kthSmallest(0) << "\n\n";
+
 
 //    for(int i=0;i<listSize;i++) cout << list[i] << " ";
 //    cout << endl;
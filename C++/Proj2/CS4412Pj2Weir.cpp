@@ -1,6 +1,36 @@
 # include <iostream>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <fstream>
+#include <iterator>
 #include <list>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 /**
@@ -16,14 +46,20 @@ using namespace std;
 class Address; // Encapsulates the street number, street name, city, state, and zip code.
 class AreaCode; // Represents the area code of a phone number.
 class CountryCode; // Represents the country code of the phone number.
+template <typename KeyOf> class ConcurrentDictionary; // Sharded PhoneEntry table with lock-free lookups for multithreaded services
+class DirectorySnapshot; // A PhoneDirectory saved in a binary file that is used straight from an mmap
+class EntryStore; // Holds each PhoneEntry once, addressed by a stable EntryId
+class FrozenDirectory; // Read-only directory indexes on minimal perfect hashes
 class Dictionary; // Contains a “hashtable” array of references to instances of the PhoneEntry class
 class ReverseDictionary; // Reverse phone directory into the same set of phone entry class instances by hashing the ascii value of the phone numbers (country, area, phone number) into an unsigned integer representing the number of buckets.
 class City; // Represents the city.
 class Name; // Handling first names, middle names, and last names.
 class Phone; // Reference to an instance of a Name class, an Address Class, and a PhoneNum Class.
+class PhoneDirectory; // An EntryStore plus the last name, first name, full name, and phone number indexes into it
 class PhoneEntry; // Encapsulates a person's name, address, and phone number
 class PhoneNumber; // Represents a phone number, including the area code and the phone number itself.
 class State; // Represents the state.
+class StringPool; // Interns the strings of the PhoneEntry components as 32-bit symbols
 class StreetName; // Represents the name of a street.
 class StreetNum; // Represents the street number.
 class Zip; // Represents the zip code.
@@ -39,41 +75,846 @@ class Zip; // Represents the zip code.
  */
 
 
+/**
+ * Instrumentation of the directory: operation counters, probe, chain and latency histograms.
+ * Compile with -DDIRECTORY_STATS to turn it on, without it DIRECTORY_STAT(...) expands to nothing and the lookups
+ * carry no extra code. Load factors and memory use are worked out when asked for, so they are always available.
+ */
+#ifdef DIRECTORY_STATS
+#define DIRECTORY_STAT(...) __VA_ARGS__
+const bool directoryStatsEnabled = true;
+#else
+#define DIRECTORY_STAT(...)
+const bool directoryStatsEnabled = false;
+#endif
+
+// Adds to a statistics counter, see Histogram for why it is not a fetch_add
+inline void bump(atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+/**
+ * @class Histogram
+ * @details Counts values in power of two buckets, bucket 0 is the value 0 and bucket i holds [2^(i-1), 2^i).
+ * The counts are atomics bumped with a plain load and store rather than a locked add, so concurrent readers of a
+ * directory can record into the same one safely, at the price of a count now and then being lost between them.
+ */
+class Histogram {
+private:
+    static constexpr size_t bucketCount = 48;
+    atomic<uint64_t> buckets[bucketCount] = {};
+
+public:
+    void record(uint64_t value) {
+        size_t bucket = value == 0 ? 0 : size_t(64 - __builtin_clzll(value));
+        bump(buckets[min(bucket, bucketCount - 1)]);
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const atomic<uint64_t>& bucket : buckets) total += bucket.load(memory_order_relaxed);
+        return total;
+    }
+    // Upper end of the bucket the p-th fraction of the values falls in, e.g. percentile(0.99)
+    uint64_t percentile(double p) const {
+        uint64_t total = count(), seen = 0;
+        for (size_t i = 0; i < bucketCount; i++) {
+            seen += buckets[i].load(memory_order_relaxed);
+            if (total > 0 && double(seen) >= p * double(total)) {
+                return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+            }
+        }
+        return 0;
+    }
+
+    // {"count":..,"p50":..,"p90":..,"p99":..,"buckets":[..]} with the buckets up to the last one in use
+    string toJson() const {
+        size_t used = bucketCount;
+        while (used > 0 && buckets[used - 1].load(memory_order_relaxed) == 0) used--;
+        string json = "{\"count\":" + to_string(count()) + ",\"p50\":" + to_string(percentile(0.5)) + ",\"p90\":"
+                      + to_string(percentile(0.9)) + ",\"p99\":" + to_string(percentile(0.99)) + ",\"buckets\":[";
+        for (size_t i = 0; i < used; i++) {
+            json += (i > 0 ? "," : "") + to_string(buckets[i].load(memory_order_relaxed));
+        }
+        return json + "]}";
+    }
+};
+
+
+/**
+ * @class FlatTable
+ * @details Open addressing hash table laid out like a Swiss table, the directory indexes are built on it.
+ * Entries sit inline in one contiguous slots array, next to it is one control byte per slot:
+ *  - ctrlEmpty / ctrlDeleted for free slots (high bit set)
+ *  - the low 7 bits of the hash (h2) for a full slot
+ * The rest of the hash (h1) picks a group of 16 slots. One SSE2 compare checks all 16 control bytes against h2,
+ * so a lookup usually reads one group of control bytes and one slot, instead of walking a linked list.
+ * Groups are probed quadratically and no insert goes more than maxProbeBound groups from its home group.
+ * Duplicate keys are allowed, same as the old bucket lists.
+ *
+ * Growing is incremental. Once the table is 7/8 full a new layout twice the size is allocated and new entries go there,
+ * then every insert and remove moves the next migrateGroupsPerStep groups over from the old layout.
+ * Lookups check both layouts until the old one is empty, so no single insert has to rehash the whole table.
+ * @tparam T - The type stored in the slots
+ * @tparam HashOf - Functor returning the 64-bit hash of a T, used when entries move to the new layout
+ */
+template <typename T, typename HashOf>
+class FlatTable {
+private:
+    static constexpr size_t groupWidth = 16;
+    static constexpr int8_t ctrlEmpty = -128;
+    static constexpr int8_t ctrlDeleted = -2;
+    static constexpr size_t maxProbeBound = 16; // groups, an insert past this grows the table instead
+    static constexpr size_t migrateGroupsPerStep = 2;
+
+    // One set of control bytes and slots, while growing there is the new one and the old one being drained
+    struct Layout {
+        int8_t* ctrl = nullptr;
+        T* slots = nullptr;
+        size_t groupMask = 0; // number of groups - 1, always a power of two minus one
+        size_t count = 0;
+        size_t deleted = 0;
+        size_t maxProbe = 0;  // the furthest any stored entry is from its home group
+
+        size_t capacity() const { return ctrl == nullptr ? 0 : (groupMask + 1) * groupWidth; }
+    };
+
+    Layout current;
+    Layout draining;   // ctrl is nullptr when no resize is running
+    size_t drainGroup; // next group of draining to move over
+    HashOf hashOf;
+
+    static size_t h1(uint64_t hash) { return size_t(hash >> 7); }
+    static int8_t h2(uint64_t hash) { return int8_t(hash & 0x7F); }
+
+    // Bitmask of the slots in the group whose control byte equals value
+    static uint32_t matchByte(const int8_t* group, int8_t value) {
+#ifdef __SSE2__
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < groupWidth; i++) {
+            if (group[i] == value) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Bitmask of the empty or deleted slots in the group, both have the high bit set
+    static uint32_t matchFree(const int8_t* group) {
+#ifdef __SSE2__
+        return uint32_t(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < groupWidth; i++) {
+            if (group[i] < 0) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    static int lowestBit(uint32_t mask) { return __builtin_ctz(mask); }
+
+    static void allocate(Layout& layout, size_t groups) {
+        size_t slotCount = groups * groupWidth;
+        layout.ctrl = new int8_t[slotCount];
+        fill(layout.ctrl, layout.ctrl + slotCount, ctrlEmpty);
+        layout.slots = static_cast<T*>(::operator new(slotCount * sizeof(T)));
+        layout.groupMask = groups - 1;
+        layout.count = 0;
+        layout.deleted = 0;
+        layout.maxProbe = 0;
+    }
+
+    static void release(Layout& layout) {
+        for (size_t i = 0; i < layout.capacity(); i++) {
+            if (layout.ctrl[i] >= 0) layout.slots[i].~T();
+        }
+        delete[] layout.ctrl;
+        ::operator delete(layout.slots);
+        layout = Layout();
+    }
+
+    /**
+     * Puts value in the first free slot on its probe sequence
+     * @param bounded - If true, gives up instead of going past maxProbeBound groups
+     * @return false if it gave up
+     */
+    static bool place(Layout& layout, uint64_t hash, T&& value, bool bounded) {
+        size_t group = h1(hash) & layout.groupMask;
+        size_t probeLength = 0;
+        uint32_t mask;
+        while ((mask = matchFree(layout.ctrl + group * groupWidth)) == 0) {
+            probeLength++;
+            if (bounded && probeLength > maxProbeBound) {
+                return false;
+            }
+            group = (group + probeLength) & layout.groupMask;
+        }
+
+        size_t index = group * groupWidth + lowestBit(mask);
+        if (layout.ctrl[index] == ctrlDeleted) {
+            layout.deleted--;
+        }
+        layout.ctrl[index] = h2(hash);
+        new (&layout.slots[index]) T(std::move(value));
+        layout.count++;
+        layout.maxProbe = max(layout.maxProbe, probeLength);
+        return true;
+    }
+
+    // probes is increased by the number of groups read
+    template <typename Match>
+    static const T* findIn(const Layout& layout, uint64_t hash, Match& matches, size_t& probes) {
+        size_t group = h1(hash) & layout.groupMask;
+        for (size_t probe = 0; probe <= layout.maxProbe; probe++) {
+            probes++;
+            const int8_t* groupCtrl = layout.ctrl + group * groupWidth;
+            for (uint32_t mask = matchByte(groupCtrl, h2(hash)); mask != 0; mask &= mask - 1) {
+                const T& entry = layout.slots[group * groupWidth + lowestBit(mask)];
+                if (matches(entry)) {
+                    return &entry;
+                }
+            }
+            if (matchByte(groupCtrl, ctrlEmpty) != 0) {
+                return nullptr;
+            }
+            group = (group + probe + 1) & layout.groupMask;
+        }
+        return nullptr;
+    }
+
+    template <typename Match, typename Visit>
+    static void forEachMatchIn(const Layout& layout, uint64_t hash, Match& matches, Visit& visit) {
+        size_t group = h1(hash) & layout.groupMask;
+        for (size_t probe = 0; probe <= layout.maxProbe; probe++) {
+            const int8_t* groupCtrl = layout.ctrl + group * groupWidth;
+            for (uint32_t mask = matchByte(groupCtrl, h2(hash)); mask != 0; mask &= mask - 1) {
+                const T& entry = layout.slots[group * groupWidth + lowestBit(mask)];
+                if (matches(entry)) {
+                    visit(entry);
+                }
+            }
+            // An insert would have stopped at this empty slot, so nothing further along can match
+            if (matchByte(groupCtrl, ctrlEmpty) != 0) {
+                return;
+            }
+            group = (group + probe + 1) & layout.groupMask;
+        }
+    }
+
+    // Frees a slot, a group with an empty slot already ends every probe through it so no tombstone is needed there
+    static void freeSlot(Layout& layout, size_t index) {
+        layout.slots[index].~T();
+        layout.count--;
+        if (matchByte(layout.ctrl + index / groupWidth * groupWidth, ctrlEmpty) != 0) {
+            layout.ctrl[index] = ctrlEmpty;
+        } else {
+            layout.ctrl[index] = ctrlDeleted;
+            layout.deleted++;
+        }
+    }
+
+    template <typename Match>
+    static bool eraseIn(Layout& layout, uint64_t hash, Match& matches) {
+        size_t group = h1(hash) & layout.groupMask;
+        for (size_t probe = 0; probe <= layout.maxProbe; probe++) {
+            const int8_t* groupCtrl = layout.ctrl + group * groupWidth;
+            for (uint32_t mask = matchByte(groupCtrl, h2(hash)); mask != 0; mask &= mask - 1) {
+                size_t index = group * groupWidth + lowestBit(mask);
+                if (matches(layout.slots[index])) {
+                    freeSlot(layout, index);
+                    return true;
+                }
+            }
+            if (matchByte(groupCtrl, ctrlEmpty) != 0) {
+                return false;
+            }
+            group = (group + probe + 1) & layout.groupMask;
+        }
+        return false;
+    }
+
+    bool isResizing() const { return draining.ctrl != nullptr; }
+
+    // Starts moving everything into a new layout with the given number of groups
+    void startResize(size_t groups) {
+        finishResize();
+        draining = current;
+        allocate(current, groups);
+        drainGroup = 0;
+    }
+
+    // Moves the next few groups of the old layout over, and drops it once it is empty
+    void migrateStep() {
+        if (!isResizing()) {
+            return;
+        }
+        for (size_t moved = 0; moved < migrateGroupsPerStep && drainGroup <= draining.groupMask; moved++, drainGroup++) {
+            for (size_t index = drainGroup * groupWidth; index < (drainGroup + 1) * groupWidth; index++) {
+                if (draining.ctrl[index] >= 0) {
+                    T& entry = draining.slots[index];
+                    place(current, hashOf(entry), std::move(entry), false);
+                    entry.~T();
+                    // A tombstone, so lookups still probe past this group to the entries not moved yet
+                    draining.ctrl[index] = ctrlDeleted;
+                    draining.count--;
+                }
+            }
+        }
+        if (drainGroup > draining.groupMask) {
+            release(draining);
+        }
+    }
+
+    void finishResize() {
+        while (isResizing()) {
+            migrateStep();
+        }
+    }
+
+public:
+    explicit FlatTable(size_t groups = 1, HashOf hasher = HashOf()) : drainGroup(0), hashOf(hasher) {
+        size_t powerOfTwo = 1;
+        while (powerOfTwo < groups) powerOfTwo *= 2;
+        allocate(current, powerOfTwo);
+    }
+    ~FlatTable() {
+        release(current);
+        if (isResizing()) release(draining);
+    }
+
+    FlatTable(const FlatTable&) = delete;
+    FlatTable& operator=(const FlatTable&) = delete;
+
+    size_t size() const { return current.count + draining.count; }
+    size_t capacity() const { return current.capacity(); }
+    size_t longestProbe() const { return max(current.maxProbe, draining.maxProbe); }
+    // Bytes of slots and control bytes, not counting anything the entries point to
+    size_t memoryUsed() const { return (current.capacity() + draining.capacity()) * (sizeof(T) + 1); }
+    // Makes room for n entries up front, so adding them does not resize along the way
+    void reserve(size_t n) {
+        size_t groups = current.groupMask + 1;
+        while (groups * groupWidth * 7 < n * 8) groups *= 2;
+        if (groups != current.groupMask + 1) {
+            startResize(groups);
+            finishResize();
+        }
+    }
+
+    /**
+     * Inserts value, starting a resize once the table is 7/8 full or a probe gets too long
+     * @param hash - hashOf(value), passed in since the caller usually has it already
+     * @param value - What is being stored
+     */
+    void insert(uint64_t hash, T value) {
+        migrateStep();
+        if ((current.count + current.deleted + 1) * 8 > capacity() * 7) {
+            // Mostly tombstones means the same size is enough to clean it up
+            startResize(size() * 2 >= capacity() ? (current.groupMask + 1) * 2 : current.groupMask + 1);
+        }
+        while (!place(current, hash, std::move(value), true)) {
+            // A long probe in a mostly empty table means many equal hashes, growing would not shorten it
+            if (size() * 4 < capacity()) {
+                place(current, hash, std::move(value), false);
+                return;
+            }
+            startResize((current.groupMask + 1) * 2);
+        }
+    }
+
+    /**
+     * Calls visit on every entry with this hash that matches
+     * @param hash - The hash of the key being looked up
+     * @param matches - Predicate comparing an entry against the key
+     * @param visit - Called with each matching entry
+     */
+    template <typename Match, typename Visit>
+    void forEachMatch(uint64_t hash, Match matches, Visit visit) const {
+        forEachMatchIn(current, hash, matches, visit);
+        if (isResizing()) {
+            forEachMatchIn(draining, hash, matches, visit);
+        }
+    }
+
+    /**
+     * The first entry with this hash that matches, or nullptr
+     * @param probeLengths - Gets the number of groups read, only with DIRECTORY_STATS. Callers pass it for the
+     * lookups they count, not for the probes of inserts and removes
+     */
+    template <typename Match>
+    const T* findFirst(uint64_t hash, Match matches, Histogram* probeLengths = nullptr) const {
+        size_t probes = 0;
+        const T* found = findIn(current, hash, matches, probes);
+        if (found == nullptr && isResizing()) {
+            found = findIn(draining, hash, matches, probes);
+        }
+        DIRECTORY_STAT(if (probeLengths != nullptr) probeLengths->record(probes);)
+        (void)probeLengths;
+        return found;
+    }
+    template <typename Match>
+    T* findFirst(uint64_t hash, Match matches) {
+        return const_cast<T*>(static_cast<const FlatTable*>(this)->findFirst(hash, matches));
+    }
+
+    /**
+     * findFirst for many keys at once, software pipelined so the cache misses of different keys overlap:
+     * the control bytes of key i + ctrlAhead are prefetched, key i + slotAhead has its home group matched (those
+     * control bytes are cached by then) and its candidate slot prefetched, and key i is checked against that slot.
+     * @param hashes - The hash of each key
+     * @param count - Number of keys
+     * @param matches - matches(i, entry), compares an entry against key i
+     * @param found - found(i, entry or nullptr), called once per key in order
+     * @param probeLengths - Gets the number of groups read for each key, as findFirst
+     */
+    template <typename Match, typename Found>
+    void findBatch(const uint64_t* hashes, size_t count, Match matches, Found found, Histogram* probeLengths = nullptr) const {
+        const size_t ctrlAhead = 16, slotAhead = 8;
+        // Home group and its h2 matches of the keys between i and i + slotAhead
+        size_t groups[slotAhead];
+        uint32_t masks[slotAhead];
+        auto prefetchCtrl = [this](uint64_t hash) {
+            __builtin_prefetch(current.ctrl + (h1(hash) & current.groupMask) * groupWidth);
+        };
+        auto matchHome = [&](size_t i) {
+            size_t group = h1(hashes[i]) & current.groupMask;
+            uint32_t mask = matchByte(current.ctrl + group * groupWidth, h2(hashes[i]));
+            groups[i % slotAhead] = group;
+            masks[i % slotAhead] = mask;
+            if (mask != 0) __builtin_prefetch(current.slots + group * groupWidth + lowestBit(mask));
+        };
+        for (size_t i = 0; i < min(count, ctrlAhead); i++) prefetchCtrl(hashes[i]);
+        for (size_t i = 0; i < min(count, slotAhead); i++) matchHome(i);
+        for (size_t i = 0; i < count; i++) {
+            if (i + ctrlAhead < count) prefetchCtrl(hashes[i + ctrlAhead]);
+            size_t group = groups[i % slotAhead];
+            uint32_t mask = masks[i % slotAhead];
+            if (i + slotAhead < count) matchHome(i + slotAhead);
+
+            const T* entry = nullptr;
+            for (; mask != 0 && entry == nullptr; mask &= mask - 1) {
+                const T& candidate = current.slots[group * groupWidth + lowestBit(mask)];
+                if (matches(i, candidate)) entry = &candidate;
+            }
+            // Most keys are settled in their home group, the rest take the normal probe
+            if (entry == nullptr && (isResizing() || matchByte(current.ctrl + group * groupWidth, ctrlEmpty) == 0)) {
+                entry = findFirst(hashes[i], [&matches, i](const T& candidate) { return matches(i, candidate); }, probeLengths);
+            } else {
+                DIRECTORY_STAT(if (probeLengths != nullptr) probeLengths->record(1);)
+            }
+            found(i, entry);
+        }
+    }
+
+    /**
+     * Removes the first entry with this hash that matches
+     * @return true if something was removed
+     */
+    template <typename Match>
+    bool eraseFirst(uint64_t hash, Match matches) {
+        migrateStep();
+        if (eraseIn(current, hash, matches)) {
+            return true;
+        }
+        return isResizing() && eraseIn(draining, hash, matches);
+    }
+
+    // Calls visit on every entry, for scans and display
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (const Layout* layout : {&current, &draining}) {
+            for (size_t i = 0; i < layout->capacity(); i++) {
+                if (layout->ctrl[i] >= 0) visit(layout->slots[i]);
+            }
+        }
+    }
+};
+
+/**
+ * @class StringHasher
+ * @details The hash policy for the dictionaries. Adding up ASCII values made every anagram collide ("Ann Lee" and "Lee Ann"),
+ * so this is a wyhash style hash instead: short keys are read as a couple of overlapping 4/8-byte words and mixed with
+ * one 64x64->128 bit multiply, which is about as cheap as the old loop for names and phone numbers.
+ * The default seed is fixed so the same key always lands in the same place. seeded() picks a random seed per instance,
+ * so someone who knows the hash cannot build a key set that all collides.
+ * Any functor taking a string_view and returning uint64_t can be used by FlatTable in its place.
+ */
+class StringHasher {
+private:
+    static constexpr uint64_t secret0 = 0xa0761d6478bd642fULL;
+    static constexpr uint64_t secret1 = 0xe7037ed1a0b428dbULL;
+    static constexpr uint64_t secret2 = 0x8ebc6af09c88c6e3ULL;
+    static constexpr uint64_t secret3 = 0x589965cc75374cc3ULL;
+
+    uint64_t seed;
+
+    // Multiply and fold the 128 bit product back into 64 bits
+    static uint64_t mix(uint64_t a, uint64_t b) {
+        __uint128_t product = __uint128_t(a) * b;
+        return uint64_t(product) ^ uint64_t(product >> 64);
+    }
+    static uint64_t read8(const char* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+    static uint64_t read4(const char* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+public:
+    explicit StringHasher(uint64_t seedValue = 0) : seed(seedValue) {}
+
+    // A hasher with a random seed, for directories that take keys from outside
+    static StringHasher seeded() {
+        random_device device;
+        return StringHasher((uint64_t(device()) << 32) | device());
+    }
+
+    uint64_t getSeed() const { return seed; }
+
+    // Hash of an integer key such as a packed phone number
+    uint64_t operator()(uint64_t key) const {
+        return mix(key ^ seed ^ secret0, mix(seed ^ secret2, secret3) ^ secret1);
+    }
+
+    uint64_t operator()(string_view key) const {
+        const char* p = key.data();
+        size_t length = key.size();
+        uint64_t state = seed ^ mix(seed ^ secret0, secret1);
+        uint64_t a, b;
+
+        if (length <= 16) {
+            if (length >= 4) {
+                // Two overlapping reads from each end cover 4 to 16 bytes
+                size_t offset = (length >> 3) << 2;
+                a = (read4(p) << 32) | read4(p + offset);
+                b = (read4(p + length - 4) << 32) | read4(p + length - 4 - offset);
+            } else if (length > 0) {
+                a = (uint64_t(uint8_t(p[0])) << 16) | (uint64_t(uint8_t(p[length >> 1])) << 8) | uint8_t(p[length - 1]);
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t remaining = length;
+            while (remaining > 16) {
+                state = mix(read8(p) ^ secret1, read8(p + 8) ^ state);
+                p += 16;
+                remaining -= 16;
+            }
+            // The last 16 bytes, overlapping what was already mixed if the length is not a multiple of 16
+            a = read8(p + remaining - 16);
+            b = read8(p + remaining - 8);
+        }
+
+        __uint128_t product = __uint128_t(a ^ secret1) * (b ^ state);
+        a = uint64_t(product);
+        b = uint64_t(product >> 64);
+        return mix(a ^ secret0 ^ length, b ^ secret1 ^ secret2 ^ secret3);
+    }
+};
+
+/**
+ * Results of running a hash over a key set, see analyzeHash
+ */
+struct HashReport {
+    size_t keyCount = 0;
+    size_t bucketCount = 0;
+    size_t emptyBuckets = 0;
+    size_t longestBucket = 0;
+    vector<size_t> occupancy; // occupancy[k] = number of buckets holding k keys
+    double chiSquare = 0;     // against an even spread, expected to be close to bucketCount - 1
+    double zScore = 0;        // how many standard deviations chiSquare is from bucketCount - 1
+
+    void print(const string& title) const {
+        cout << title << ": " << keyCount << " keys in " << bucketCount << " buckets" << endl;
+        cout << "  Empty buckets: " << emptyBuckets << ", longest bucket: " << longestBucket << endl;
+        cout << "  Occupancy (keys: buckets):";
+        for (size_t k = 0; k < occupancy.size(); k++) {
+            if (occupancy[k] != 0) cout << " " << k << ":" << occupancy[k];
+        }
+        cout << endl;
+        cout << "  Chi-square: " << chiSquare << " (expected " << bucketCount - 1 << ", z = " << zScore << ")" << endl;
+    }
+};
+
+/**
+ * Diagnostic mode for a hash policy. Puts the keys into bucketCount buckets the way FlatTable picks a group
+ * (the hash without its low 7 tag bits) and reports the bucket occupancy and a chi-square test for uniformity.
+ * A z score within about +-3 means the spread is as good as random, a large positive one means clustering.
+ * @param keys - The key set to test, e.g. every full name in a directory
+ * @param bucketCount - Number of buckets to spread them over
+ * @param hasher - Any functor taking a string_view and returning uint64_t
+ */
+template <typename Hasher>
+HashReport analyzeHash(const vector<string>& keys, size_t bucketCount, Hasher hasher) {
+    vector<size_t> loads(bucketCount, 0);
+    for (const string& key : keys) {
+        loads[(hasher(key) >> 7) % bucketCount]++;
+    }
+
+    HashReport report;
+    report.keyCount = keys.size();
+    report.bucketCount = bucketCount;
+    double expected = double(keys.size()) / double(bucketCount);
+    for (size_t load : loads) {
+        if (load == 0) report.emptyBuckets++;
+        report.longestBucket = max(report.longestBucket, load);
+        if (report.occupancy.size() <= load) report.occupancy.resize(load + 1, 0);
+        report.occupancy[load]++;
+        report.chiSquare += (double(load) - expected) * (double(load) - expected) / expected;
+    }
+    double degrees = double(bucketCount - 1);
+    report.zScore = (report.chiSquare - degrees) / sqrt(2 * degrees);
+    return report;
+}
+
+// Id of an interned string in a StringPool
+using Symbol = uint32_t;
+
+/**
+ * @class StringPool
+ * @details Interns the strings that make up a PhoneEntry. Every distinct string is stored once in a bump arena
+ * (big char blocks that are only ever appended to) and gets a 32-bit Symbol, so a city, state or zip shared by a million
+ * entries costs 4 bytes per entry and comparing two of them is an integer compare.
+ * The arena is never compacted, strings stay interned for the life of the pool.
+ * intern() takes a lock, view() does not: the arena blocks and the chunks of views never move once written,
+ * so threads reading entries can look their strings up while another thread is interning new ones.
+ *
+ * Lifetime and limit: componentPool() is one pool for the whole process and nothing is ever removed from it. Every
+ * distinct name, address part and phone number any directory or dictionary has seen stays until the process exits,
+ * even after its entries are erased, and past 2^28 distinct strings intern() throws length_error. That suits a
+ * directory loaded from a bounded data set. A long-running service fed unbounded distinct strings has to be
+ * restarted (or reloaded from a snapshot) before it gets there. The pool's own overhead grows with use, an empty
+ * pool is a few hundred bytes and each 1024 symbols add one 16 KB chunk of views.
+ */
+class StringPool {
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+    static constexpr size_t chunkBits = 10; // 1024 views per chunk
+    static constexpr size_t chunkSize = size_t(1) << chunkBits;
+    static constexpr size_t maxChunks = size_t(1) << 18; // room for 2^28 distinct strings
+
+    // Rehashes a symbol by reading its text back from the pool
+    struct SymbolHash {
+        const StringPool* pool;
+        uint64_t operator()(Symbol symbol) const { return StringHasher()(pool->view(symbol)); }
+    };
+
+    vector<unique_ptr<char[]>> blocks;
+    size_t blockUsed = blockSize; // bytes used in blocks.back(), full to start so the first intern allocates
+    size_t arenaBytes = 0;
+    // views of symbol s is chunks[s >> chunkBits][s & (chunkSize - 1)], pointing into the arena. The chunk directory
+    // doubles when it fills up, the old copies are kept until the pool goes so a reader still holding one is safe
+    atomic<atomic<string_view*>*> chunks{nullptr};
+    vector<unique_ptr<atomic<string_view*>[]>> directories; // every chunk directory so far, the current one last
+    size_t directoryCapacity = 0;
+    size_t symbolCount = 0;
+    FlatTable<Symbol, SymbolHash> lookup;
+    mutable mutex writeLock;
+
+    void append(string_view text) {
+        size_t chunk = symbolCount >> chunkBits;
+        if ((symbolCount & (chunkSize - 1)) == 0) {
+            if (chunk == maxChunks) {
+                throw length_error("StringPool is out of symbols");
+            }
+            if (chunk == directoryCapacity) {
+                growDirectory();
+            }
+            chunks.load(memory_order_relaxed)[chunk].store(new string_view[chunkSize], memory_order_release);
+        }
+        chunks.load(memory_order_relaxed)[chunk].load(memory_order_relaxed)[symbolCount & (chunkSize - 1)] = text;
+        symbolCount++;
+    }
+
+    void growDirectory() {
+        size_t capacity = max<size_t>(16, directoryCapacity * 2);
+        unique_ptr<atomic<string_view*>[]> grown(new atomic<string_view*>[capacity]());
+        for (size_t i = 0; i < directoryCapacity; i++) {
+            grown[i].store(directories.back()[i].load(memory_order_relaxed), memory_order_relaxed);
+        }
+        chunks.store(grown.get(), memory_order_release);
+        directories.push_back(std::move(grown));
+        directoryCapacity = capacity;
+    }
+
+    // Copies text into the arena, strings longer than a block get a block of their own
+    string_view store(string_view text) {
+        if (text.empty()) {
+            return string_view();
+        }
+        if (text.size() > blockSize) {
+            unique_ptr<char[]> own(new char[text.size()]);
+            memcpy(own.get(), text.data(), text.size());
+            string_view stored(own.get(), text.size());
+            // In front of the current block, so later strings keep filling that one
+            blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, std::move(own));
+            arenaBytes += text.size();
+            return stored;
+        }
+        if (blockUsed + text.size() > blockSize) {
+            blocks.emplace_back(new char[blockSize]);
+            blockUsed = 0;
+            arenaBytes += blockSize;
+        }
+        char* destination = blocks.back().get() + blockUsed;
+        memcpy(destination, text.data(), text.size());
+        blockUsed += text.size();
+        return string_view(destination, text.size());
+    }
+
+public:
+    StringPool() : lookup(1, SymbolHash{this}) {}
+    ~StringPool() {
+        for (size_t chunk = 0; chunk * chunkSize < symbolCount; chunk++) {
+            delete[] chunks.load()[chunk].load();
+        }
+    }
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // The symbol for text, adding it to the pool the first time it is seen
+    Symbol intern(string_view text) {
+        uint64_t hashValue = StringHasher()(text);
+        lock_guard<mutex> guard(writeLock);
+        const Symbol* found = lookup.findFirst(hashValue, [this, text](Symbol symbol) { return view(symbol) == text; });
+        if (found != nullptr) {
+            return *found;
+        }
+        Symbol symbol = Symbol(symbolCount);
+        append(store(text));
+        lookup.insert(hashValue, symbol);
+        return symbol;
+    }
+
+    /**
+     * Interns many strings under one lock acquisition, for bulk loads where threads collect their strings first
+     * @param texts - The strings
+     * @param hashes - StringHasher()(texts[i]) for each one, computed by the caller outside the lock
+     * @param count - Number of strings
+     * @param symbols - Gets the symbol of each string
+     */
+    void internBatch(const string_view* texts, const uint64_t* hashes, size_t count, Symbol* symbols) {
+        lock_guard<mutex> guard(writeLock);
+        for (size_t i = 0; i < count; i++) {
+            string_view text = texts[i];
+            const Symbol* found = lookup.findFirst(hashes[i], [this, text](Symbol symbol) { return view(symbol) == text; });
+            if (found != nullptr) {
+                symbols[i] = *found;
+                continue;
+            }
+            symbols[i] = Symbol(symbolCount);
+            append(store(text));
+            lookup.insert(hashes[i], symbols[i]);
+        }
+    }
+
+    // Looks text up without adding it, returns false if it was never interned
+    bool find(string_view text, Symbol& symbol) const {
+        lock_guard<mutex> guard(writeLock);
+        const Symbol* found = lookup.findFirst(StringHasher()(text), [this, text](Symbol other) { return view(other) == text; });
+        if (found != nullptr) {
+            symbol = *found;
+        }
+        return found != nullptr;
+    }
+
+    string_view view(Symbol symbol) const {
+        return chunks.load(memory_order_acquire)[symbol >> chunkBits].load(memory_order_acquire)[symbol & (chunkSize - 1)];
+    }
+    string str(Symbol symbol) const { return string(view(symbol)); }
+
+    size_t size() const { return symbolCount; }
+    size_t memoryUsed() const {
+        size_t chunkCount = (symbolCount + chunkSize - 1) >> chunkBits;
+        size_t directoryBytes = 0;
+        for (size_t capacity = directoryCapacity; capacity >= 16; capacity /= 2) directoryBytes += capacity * sizeof(atomic<string_view*>);
+        return arenaBytes + directoryBytes + chunkCount * chunkSize * sizeof(string_view)
+               + lookup.capacity() * (sizeof(Symbol) + 1);
+    }
+};
+
+// The pool shared by every PhoneEntry component
+StringPool& componentPool() {
+    static StringPool pool;
+    return pool;
+}
+// The symbol of the empty string, looked up once
+Symbol emptySymbol() {
+    static const Symbol empty = componentPool().intern("");
+    return empty;
+}
+
 // AreaCode Class
 class AreaCode {
 private:
-    string areaCode;
+    Symbol areaCode;
 public:
-    AreaCode(const string& code) : areaCode(code) {}
-    string getAreaCode() const {return areaCode; }
+    AreaCode(string_view code) : areaCode(componentPool().intern(code)) {}
+    explicit AreaCode(Symbol code) : areaCode(code) {}
+    string getAreaCode() const {return componentPool().str(areaCode); }
+    Symbol getSymbol() const { return areaCode; }
 };
 
 // City Class
 class City {
 private:
-    string cityName;
+    Symbol cityName;
 public:
-    City(const string& city) : cityName(city) {}
-    string getCity() const { return cityName; }
+    City(string_view city) : cityName(componentPool().intern(city)) {}
+    explicit City(Symbol city) : cityName(city) {}
+    string getCity() const { return componentPool().str(cityName); }
+    Symbol getSymbol() const { return cityName; }
+    bool operator==(const City& other) const { return cityName == other.cityName; }
 };
 
 class CountryCode{
-private:string countryCode;
+private:Symbol countryCode;
 public:
-    CountryCode(const string& code) : countryCode(code){}
-    string getCountryCode() const { return countryCode;}
+    CountryCode(string_view code) : countryCode(componentPool().intern(code)){}
+    explicit CountryCode(Symbol code) : countryCode(code) {}
+    string getCountryCode() const { return componentPool().str(countryCode);}
+    Symbol getSymbol() const { return countryCode; }
 };
 
 /**
  *
  * @class Name
  * @details This class gets the first, last, middle, initials, and full name of the person. As well as canonicalize the names.
+ * The names are kept as symbols in the componentPool, so equal names compare as integers.
  *
  */
 class Name {
 private:
-    string firstName, middleName, lastName;
+    Symbol firstName, middleName, lastName;
+
 public:
+    // Removes leading and trailing spaces, as a view into text
+    static string_view trimPart(string_view text) {
+        while (!text.empty() && isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+        while (!text.empty() && isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+        return text;
+    }
+    // Writes a trimmed part with the first character uppercase and the rest lowercase, out has room for part.size()
+    static void writeCanonical(string_view part, char* out) {
+        for (size_t i = 0; i < part.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(part[i]);
+            out[i] = char(i == 0 ? toupper(c) : tolower(c));
+        }
+    }
+    // Whether a trimmed part is already canonical and can be interned as it is
+    static bool isCanonical(string_view part) {
+        for (size_t i = 0; i < part.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(part[i]);
+            if (char(i == 0 ? toupper(c) : tolower(c)) != part[i]) return false;
+        }
+        return true;
+    }
+    // Trims the spaces and makes the first character uppercase and the rest lowercase
+    static string canonicalPart(string_view text) {
+        string part(trimPart(text));
+        writeCanonical(part, &part[0]);
+        return part;
+    }
 
     /**
      *
@@ -81,62 +922,169 @@ public:
      * @param first Initializes First Name
      * @param middle Initializes Middle Name
      * @param last Initializes Last Name
-     * Calls the canonicalize() function to format the names
+     * Each part is formatted the same way canonicalize() does before it is interned: trimmed, first letter uppercase and
+     * the rest lowercase, so "  jOHN " is stored as "John" and the getters return that form, not what was passed in
      */
-    Name(const string& first, const string& middle, const string& last)
-            : firstName(first), middleName(middle), lastName(last) {
-        canonicalize();
+    Name(string_view first, string_view middle, string_view last)
+            : firstName(componentPool().intern(canonicalPart(first))), middleName(componentPool().intern(canonicalPart(middle))),
+              lastName(componentPool().intern(canonicalPart(last))) {
     }
+    // From parts that were made canonical and interned already, e.g. by a bulk load
+    Name(Symbol first, Symbol middle, Symbol last) : firstName(first), middleName(middle), lastName(last) {}
     // Getters
-    string getName(){
-        return lastName + middleName + firstName;
+    string getName() const {
+        StringPool& pool = componentPool();
+        string name;
+        name.reserve(pool.view(lastName).size() + pool.view(middleName).size() + pool.view(firstName).size());
+        return name.append(pool.view(lastName)).append(pool.view(middleName)).append(pool.view(firstName));
+    }
+    // getName() interned, joined on the stack unless it is long
+    Symbol internName() const {
+        StringPool& pool = componentPool();
+        string_view parts[3] = {pool.view(lastName), pool.view(middleName), pool.view(firstName)};
+        char joined[256];
+        if (parts[0].size() + parts[1].size() + parts[2].size() > sizeof(joined)) {
+            return pool.intern(getName());
+        }
+        size_t length = 0;
+        for (string_view part : parts) {
+            part.copy(joined + length, part.size()); // not memcpy, an empty part may have no data pointer
+            length += part.size();
+        }
+        return pool.intern(string_view(joined, length));
     }
-    string getFML(){
-        return firstName + middleName + lastName;
+    string getFML() const {
+        return getFirstName() + componentPool().str(middleName) + getLastName();
     }
-    string getInitials(){
-        return lastName.substr(0, 1) + middleName.substr(0, 1) + firstName.substr(0, 1);
+    string getInitials() const {
+        StringPool& pool = componentPool();
+        return string(pool.view(lastName).substr(0, 1)) + string(pool.view(middleName).substr(0, 1)) + string(pool.view(firstName).substr(0, 1));
     }
-    string getLastName(){
-        return lastName;
+    string getLastName() const {
+        return componentPool().str(lastName);
     }
     string getFirstName() const {
-        return firstName;
+        return componentPool().str(firstName);
     }
+    Symbol getLastNameSymbol() const { return lastName; }
+    Symbol getFirstNameSymbol() const { return firstName; }
+    Symbol getMiddleNameSymbol() const { return middleName; }
 
     // Purpose is to ensure that the names are in a consistent and expected format as per the requirement of the asignment
     void canonicalize(){
-        // Remove leading and trailing spaces
-        firstName.erase(firstName.begin(), find_if(firstName.begin(), firstName.end(), [](char c) { return !isspace(c); }));
-        firstName.erase(find_if(firstName.rbegin(), firstName.rend(), [](char c) { return !isspace(c); }).base(), firstName.end());
+        StringPool& pool = componentPool();
+        firstName = pool.intern(canonicalPart(pool.str(firstName)));
+        middleName = pool.intern(canonicalPart(pool.str(middleName)));
+        lastName = pool.intern(canonicalPart(pool.str(lastName)));
+    }
+};
 
-        middleName.erase(middleName.begin(), find_if(middleName.begin(), middleName.end(), [](char c) { return !isspace(c); }));
-        middleName.erase(find_if(middleName.rbegin(), middleName.rend(), [](char c) { return !isspace(c); }).base(), middleName.end());
+/**
+ * A phone number packed into 64 bits as (country, area, subscriber), so reverse lookups hash and compare one integer.
+ * Each part is a string of digits stored as its value plus the count of all shorter digit strings, which keeps
+ * leading zeros apart ("020" is not "20"):
+ *  bits 51-61 country code, up to 3 digits
+ *  bits 37-50 area code, up to 4 digits
+ *  bits 0-36  subscriber number, up to 11 digits
+ * A number that does not fit has bit 63 set and the Symbol of its interned text in the low bits instead.
+ */
+using PhoneKey = uint64_t;
+const PhoneKey phoneKeySymbolFlag = PhoneKey(1) << 63;
 
-        lastName.erase(lastName.begin(), find_if(lastName.begin(), lastName.end(), [](char c) { return !isspace(c); }));
-        lastName.erase(find_if(lastName.rbegin(), lastName.rend(), [](char c) { return !isspace(c); }).base(), lastName.end());
+// Number of digit strings shorter than length, 0 + 1 + 10 + 100 + ...
+constexpr uint64_t shorterDigitStrings(size_t length) {
+    return length == 0 ? 0 : shorterDigitStrings(length - 1) * 10 + 1;
+}
 
-        // Uppercase first character, lowercase the rest
-        if (!firstName.empty())
-            firstName[0] = toupper(firstName[0]);
-        transform(firstName.begin() + 1, firstName.end(), firstName.begin() + 1, ::tolower);
+/**
+ * Parses a phone number written as digit groups, any run of non-digits separates groups. How many groups there are
+ * says what they are:
+ *  1 group   subscriber
+ *  2 groups  area-subscriber
+ *  3 groups  area-exchange-line, a number with no country code
+ *  4 or more country-area-subscriber, every group after the area code belongs to the subscriber number
+ * A '+' before the first digit always makes the first group the country code, whatever the number of groups.
+ * So "555-123-4567" and "(555) 123-4567" are area 555 subscriber 1234567, "1-555-123-4567", "+1 555 123 4567" and
+ * "+1.555.1234567" are that number with country code 1. A number written without its country code is a different
+ * key from the one written with it, it only finds entries that were stored without one.
+ * @return The packed key, or nothing if there are no digits or a part is too long
+ */
+optional<PhoneKey> packPhoneNumber(string_view text) {
+    const char* digits = "0123456789";
+    size_t groupCount = 0;
+    for (size_t position = 0; (position = text.find_first_of(digits, position)) != string_view::npos; groupCount++) {
+        position = min(text.size(), text.find_first_not_of(digits, position));
+    }
+    if (groupCount == 0) {
+        return nullopt;
+    }
+    size_t firstDigit = text.find_first_of(digits);
+    bool plus = text.substr(0, firstDigit).find('+') != string_view::npos;
+    size_t countryGroups = plus || groupCount >= 4 ? 1 : 0;
+    size_t areaGroups = groupCount - countryGroups >= 2 ? 1 : 0;
 
-        if (!middleName.empty())
-            middleName[0] = toupper(middleName[0]);
-        transform(middleName.begin() + 1, middleName.end(), middleName.begin() + 1, ::tolower);
+    string_view country, area;
+    uint64_t subscriber = 0;
+    size_t subscriberDigits = 0;
+    size_t position = firstDigit;
+    for (size_t group = 0; group < groupCount; group++) {
+        position = text.find_first_of(digits, position);
+        size_t end = min(text.size(), text.find_first_not_of(digits, position));
+        string_view part = text.substr(position, end - position);
+        position = end;
+        if (group < countryGroups) {
+            country = part;
+        } else if (group < countryGroups + areaGroups) {
+            area = part;
+        } else {
+            subscriberDigits += part.size();
+            if (subscriberDigits > 11) {
+                return nullopt;
+            }
+            for (char digit : part) {
+                subscriber = subscriber * 10 + uint64_t(digit - '0');
+            }
+        }
+    }
+    if (country.size() > 3 || area.size() > 4) {
+        return nullopt;
+    }
+    auto encode = [](string_view part) {
+        uint64_t value = 0;
+        for (char digit : part) value = value * 10 + uint64_t(digit - '0');
+        return value + shorterDigitStrings(part.size());
+    };
+    return (encode(country) << 51) | (encode(area) << 37) | (subscriber + shorterDigitStrings(subscriberDigits));
+}
 
-        if (!lastName.empty())
-            lastName[0] = toupper(lastName[0]);
-        transform(lastName.begin() + 1, lastName.end(), lastName.begin() + 1, ::tolower);
+// Writes a packed key back out as country-area-subscriber, leaving out the parts that are not there
+string formatPhoneKey(PhoneKey key) {
+    if (key & phoneKeySymbolFlag) {
+        return componentPool().str(Symbol(key));
     }
-};
+    auto decode = [](uint64_t value) {
+        size_t length = 0;
+        while (shorterDigitStrings(length + 1) <= value) length++;
+        if (length == 0) {
+            return string();
+        }
+        string part = to_string(value - shorterDigitStrings(length));
+        return string(length - min(length, part.size()), '0') + part;
+    };
+    string country = decode(key >> 51), area = decode((key >> 37) & ((1 << 14) - 1)), subscriber = decode(key & ((PhoneKey(1) << 37) - 1));
+    string text;
+    if (!country.empty()) text += country + "-";
+    if (!area.empty()) text += area + "-";
+    return text + subscriber;
+}
 
 // PhoneNumber Class
 class PhoneNumber {
 private:
     CountryCode countryCode;
     AreaCode areaCode;
-    string number;
+    Symbol number;
+    PhoneKey key;
 public:
     /**
      *
@@ -144,48 +1092,76 @@ public:
      * @param ac represents the area code of the phone number.
      * @param num represents the main part of the phone number.
      */
-    PhoneNumber(const CountryCode& cc, const AreaCode& ac, const string& num)
-            : countryCode(cc), areaCode(ac), number(num) {}
+    PhoneNumber(const CountryCode& cc, const AreaCode& ac, string_view num)
+            : PhoneNumber(cc, ac, componentPool().intern(num)) {}
+    // From a number that was interned already
+    PhoneNumber(const CountryCode& cc, const AreaCode& ac, Symbol num) : countryCode(cc), areaCode(ac), number(num) {
+        StringPool& pool = componentPool();
+        bool hasCountry = !pool.view(cc.getSymbol()).empty();
+        optional<PhoneKey> packed;
+        if (hasCountry || !pool.view(ac.getSymbol()).empty()) {
+            // A separate country code is spelled with a '+', so packPhoneNumber reads it as the country
+            packed = packPhoneNumber((hasCountry ? "+" : "") + getFullPhoneNumber());
+        } else {
+            packed = packPhoneNumber(pool.view(num));
+        }
+        key = packed ? *packed : phoneKeySymbolFlag | number;
+    }
 
-    string getPhoneNumber() const { return number; }
-    string getFullPhoneNumber() const {return countryCode.getCountryCode() +"-"+ areaCode.getAreaCode() +"-"+ number; }
+    string getPhoneNumber() const { return componentPool().str(number); }
+    string getFullPhoneNumber() const {return countryCode.getCountryCode() +"-"+ areaCode.getAreaCode() +"-"+ getPhoneNumber(); }
+    Symbol getSymbol() const { return number; }
+    // The number packed as (country, area, subscriber), see packPhoneNumber
+    PhoneKey getKey() const { return key; }
+    const CountryCode& getCountryCode() const { return countryCode; }
+    const AreaCode& getAreaCode() const { return areaCode; }
 };
 
 // State Class
 class State {
 private:
-    string stateName;
+    Symbol stateName;
 public:
-    State(const string& state) : stateName(state) {}
-    string getState() const { return stateName; }
+    State(string_view state) : stateName(componentPool().intern(state)) {}
+    explicit State(Symbol state) : stateName(state) {}
+    string getState() const { return componentPool().str(stateName); }
+    Symbol getSymbol() const { return stateName; }
+    bool operator==(const State& other) const { return stateName == other.stateName; }
 };
 
 // StreetName Class
 class StreetName {
 private:
-    string name;
+    Symbol name;
 public:
-    StreetName(const string& n) : name(n) {}
-    string getName() const { return name; }
+    StreetName(string_view n) : name(componentPool().intern(n)) {}
+    explicit StreetName(Symbol n) : name(n) {}
+    string getName() const { return componentPool().str(name); }
+    Symbol getSymbol() const { return name; }
 };
 
 // StreetNum Class
 class StreetNum {
 private:
-    // Chose type basic_string<char>, which allows for more flexibility in representing street numbers.
-    basic_string<char> number;
+    // Kept as an interned string, which allows for more flexibility in representing street numbers.
+    Symbol number;
 public:
-    StreetNum(basic_string<char> num) : number(num) {}
-    const basic_string<char> getNumber() const {return number; }
+    StreetNum(string_view num) : number(componentPool().intern(num)) {}
+    explicit StreetNum(Symbol num) : number(num) {}
+    const basic_string<char> getNumber() const {return componentPool().str(number); }
+    Symbol getSymbol() const { return number; }
 };
 
 // Zip Class
 class Zip{
 private:
-    string zipCode;
+    Symbol zipCode;
 public:
-    string getZip() const{return zipCode;}
-    Zip(const string& zip) : zipCode(zip) {}
+    string getZip() const{return componentPool().str(zipCode);}
+    Zip(string_view zip) : zipCode(componentPool().intern(zip)) {}
+    explicit Zip(Symbol zip) : zipCode(zip) {}
+    Symbol getSymbol() const { return zipCode; }
+    bool operator==(const Zip& other) const { return zipCode == other.zipCode; }
 };
 
 // Address Class
@@ -212,6 +1188,12 @@ public:
     string getDisplayString() const {
         return streetNum.getNumber() + " " + streetName.getName() + ", " + city.getCity() + ", " + state.getState() + " " + zip.getZip();
     }
+
+    const StreetNum& getStreetNum() const { return streetNum; }
+    const StreetName& getStreetName() const { return streetName; }
+    const City& getCity() const { return city; }
+    const State& getState() const { return state; }
+    const Zip& getZip() const { return zip; }
 };
 
 // PhoneEntry Class
@@ -220,8 +1202,17 @@ private:
     Name name;
     Address address;
     PhoneNumber phoneNumber;
+    // The canonical full name, interned like the parts so the entry stays small, and its hash under the directory's hasher
+    Symbol fullName;
+    uint64_t fullNameHash = 0;
 
 public:
+    // The components of an entry already interned, the name parts canonical, see loadDirectoryCsv
+    struct Parts {
+        Symbol first, middle, last, streetNum, street, city, state, zip, phone;
+        Symbol fullName; // last + middle + first
+    };
+
     /**
      * Initializing the members of the PhoneEntry class
      * @param first - Represents first name
@@ -234,34 +1225,47 @@ public:
      * @param zip - Represents zip
      * @param phone - Represents phone
      */
-    PhoneEntry(const string& first, const string& middle, const string& last, const string& streetnum, const string& street, const string& city,
-               const string& state, const string& zip, const string& phone)
+    PhoneEntry(string_view first, string_view middle, string_view last, string_view streetnum, string_view street, string_view city,
+               string_view state, string_view zip, string_view phone)
             : name(first, middle, last), address(StreetNum(streetnum), StreetName(street), City(city), State(state), Zip(zip)),
-            phoneNumber(CountryCode(""),AreaCode(""), phone) {}
+            phoneNumber(CountryCode(""),AreaCode(""), phone), fullName(name.internName()) {}
+    // Builds the entry from interned components without touching the pool's lock
+    explicit PhoneEntry(const Parts& parts)
+            : name(parts.first, parts.middle, parts.last),
+              address(StreetNum(parts.streetNum), StreetName(parts.street), City(parts.city), State(parts.state), Zip(parts.zip)),
+              phoneNumber(CountryCode(emptySymbol()), AreaCode(emptySymbol()), parts.phone), fullName(parts.fullName) {}
 
-    string getDisplayString(){
+    string getDisplayString() const {
         return name.getName() + " - " + phoneNumber.getPhoneNumber() + "\n" + address.getDisplayString();
     }
 
     //Getters
-    string getInitials(){
+    string getInitials() const {
         return name.getInitials();
     }
-    string getFullName() {
-        return name.getName();
+    string getFullName() const {
+        return componentPool().str(fullName);
     }
     string getFirstName() const {
         return name.getFirstName();
     }
-    string getLastName(){
+    string getLastName() const {
         return name.getLastName();
     }
-    string getFML(){
+    string getFML() const {
         return name.getFML();
     }
-    string getPhoneNumber(){
+    string getPhoneNumber() const {
         return phoneNumber.getPhoneNumber();
     }
+    const Name& getName() const { return name; }
+    const Address& getAddress() const { return address; }
+    const PhoneNumber& getPhone() const { return phoneNumber; }
+    string_view getFullNameKey() const { return componentPool().view(fullName); }
+    uint64_t getFullNameHash() const { return fullNameHash; }
+
+    // Called by the EntryStore when the entry is added, so the indexes never hash the name again
+    void hashFullName(StringHasher hasher) { fullNameHash = hasher(getFullNameKey()); }
 };
 
 // Phone Class
@@ -280,154 +1284,2925 @@ public:
     }
 };
 
-class Dictionary {
+// Stable handle to an entry in an EntryStore
+using EntryId = uint32_t;
+
+/**
+ * @class EntryStore
+ * @details Holds every PhoneEntry exactly once in one contiguous array. An entry keeps its EntryId until it is erased,
+ * after that the id goes on a free list and is handed out again by the next add.
+ * Each entry's full name hash is computed here with the directory's hasher as it is added.
+ */
+class EntryStore {
 private:
-    static const int bucketNum = 8;
-    list<PhoneEntry> buckets[bucketNum]; // Use an array of lists
+    vector<optional<PhoneEntry>> entries;
+    vector<EntryId> freeIds;
+    size_t count = 0;
+    StringHasher hasher;
 
-    // Hash function that accepts the string containing the lastName+MiddleInitial+FirstName and returns an integer between 0 and 7
-    int hash(const string &key) const {
-        // Calculate a hash value based on the key (e.g., full name)
-        size_t hashValue = 0;
-        for (char index : key) {
-            // Simple hash function using character ASCII values
-            hashValue += index;
-        }
-        // Use modulo division to map the hash value to a bucket index
-        return hashValue % bucketNum;
-    }
+public:
+    explicit EntryStore(StringHasher hashPolicy = StringHasher()) : hasher(hashPolicy) {}
+
+
+    // Builds the entry in place from the PhoneEntry constructor arguments
+    template <typename... Args>
+    EntryId emplace(Args&&... args) {
+        EntryId id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+            entries[id].emplace(std::forward<Args>(args)...);
+        } else {
+            id = EntryId(entries.size());
+            entries.emplace_back(in_place, std::forward<Args>(args)...);
+        }
+        entries[id]->hashFullName(hasher);
+        count++;
+        return id;
+    }
+    EntryId add(PhoneEntry entry) {
+        return emplace(std::move(entry));
+    }
+    void reserve(size_t n) {
+        entries.reserve(n);
+    }
+
+    void erase(EntryId id) {
+        entries[id].reset();
+        freeIds.push_back(id);
+        count--;
+    }
+
+    const PhoneEntry& get(EntryId id) const { return *entries[id]; }
+    bool contains(EntryId id) const { return id < entries.size() && entries[id].has_value(); }
+    size_t size() const { return count; }
+    const StringHasher& getHasher() const { return hasher; }
+    size_t memoryUsed() const { return entries.capacity() * sizeof(optional<PhoneEntry>) + freeIds.capacity() * sizeof(EntryId); }
+
+    // Calls visit(id, entry) for every entry in id order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (EntryId id = 0; id < entries.size(); id++) {
+            if (entries[id]) visit(id, *entries[id]);
+        }
+    }
+};
+
+/**
+ * @class EntryRange
+ * @details What a lookup returns, a view over the matching entries in the store instead of a list of copies.
+ * Iterating gives const PhoneEntry& and nothing is allocated. Like any iterator it is only valid until the directory
+ * it came from is changed.
+ */
+class EntryRange {
+private:
+    const EntryStore* store;
+    const EntryId* first;
+    const EntryId* last;
+
+public:
+    class iterator {
+    private:
+        const EntryStore* store;
+        const EntryId* position;
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = PhoneEntry;
+        using difference_type = ptrdiff_t;
+        using pointer = const PhoneEntry*;
+        using reference = const PhoneEntry&;
+
+        iterator(const EntryStore* entryStore, const EntryId* at) : store(entryStore), position(at) {}
+        const PhoneEntry& operator*() const { return store->get(*position); }
+        const PhoneEntry* operator->() const { return &store->get(*position); }
+        iterator& operator++() { ++position; return *this; }
+        iterator operator++(int) { iterator before = *this; ++position; return before; }
+        bool operator==(const iterator& other) const { return position == other.position; }
+        bool operator!=(const iterator& other) const { return position != other.position; }
+        // The id of the entry the iterator is on
+        EntryId id() const { return *position; }
+    };
+
+    EntryRange() : store(nullptr), first(nullptr), last(nullptr) {}
+    EntryRange(const EntryStore* entryStore, const EntryId* begin, const EntryId* end) : store(entryStore), first(begin), last(end) {}
+
+    iterator begin() const { return iterator(store, first); }
+    iterator end() const { return iterator(store, last); }
+    size_t size() const { return size_t(last - first); }
+    bool empty() const { return first == last; }
+    const PhoneEntry& front() const { return store->get(*first); }
+};
+
+// A Soundex code held in place, so making and comparing one allocates nothing. Reads as a string_view.
+struct SoundexCode {
+    array<char, 4> letters{};
+    size_t length = 0; // 4, or 0 for a name with no letters
+
+    bool operator==(const SoundexCode& other) const { return length == other.length && letters == other.letters; }
+    bool operator!=(const SoundexCode& other) const { return !(*this == other); }
+    operator string_view() const { return string_view(letters.data(), length); }
+};
+
+/**
+ * American Soundex code of a name, the first letter followed by three digits for the consonant sounds, e.g.
+ * Robert and Rupert are both R163. Anything that is not a letter is skipped.
+ * @return The code, empty if the name has no letters
+ */
+SoundexCode soundex(string_view name) {
+    // Digit for each letter a-z, 0 for the vowels and h, w, y
+    static const char codes[] = "01230120022455012623010202";
+    SoundexCode code;
+    char previous = 0;
+    for (char c : name) {
+        if (!isalpha(static_cast<unsigned char>(c))) {
+            continue;
+        }
+        char lower = char(tolower(static_cast<unsigned char>(c)));
+        char digit = codes[lower - 'a'];
+        if (code.length == 0) {
+            code.letters[code.length++] = char(toupper(static_cast<unsigned char>(c)));
+        } else if (digit != '0' && digit != previous) {
+            code.letters[code.length++] = digit;
+            if (code.length == 4) {
+                return code;
+            }
+        }
+        // h and w do not separate two letters with the same code, vowels do
+        if (lower != 'h' && lower != 'w') {
+            previous = digit;
+        }
+    }
+    if (code.length != 0) {
+        fill(code.letters.begin() + code.length, code.letters.end(), '0');
+        code.length = 4;
+    }
+    return code;
+}
+
+/**
+ * Levenshtein distance, the fewest single character inserts, deletes and substitutions that turn a into b
+ */
+size_t editDistance(string_view a, string_view b) {
+    if (a.size() < b.size()) {
+        swap(a, b);
+    }
+    // One row of the table, kept on the stack for names of normal length
+    size_t stackRow[64];
+    vector<size_t> heapRow;
+    size_t* row = stackRow;
+    if (b.size() + 1 > 64) {
+        heapRow.resize(b.size() + 1);
+        row = heapRow.data();
+    }
+    for (size_t j = 0; j <= b.size(); j++) row[j] = j;
+    for (size_t i = 1; i <= a.size(); i++) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            size_t above = row[j];
+            row[j] = min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1)});
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+/**
+ * Keys the directory indexes entries by. Each one has
+ *  - key(), the key as a string, only used when an entry is added or removed
+ *  - matches(), compares an entry against a looked up key straight from the interned parts without building a string
+ *  - hashCached, true when the entry carries the key's hash from insert, then hash() returns it and probes compare
+ *    the hashes before the strings
+ */
+struct LastNameKey {
+    static constexpr bool hashCached = false;
+    static string key(const PhoneEntry& entry) { return entry.getLastName(); }
+    static Symbol symbol(const PhoneEntry& entry) { return entry.getName().getLastNameSymbol(); }
+    static bool matches(const PhoneEntry& entry, string_view key) {
+        return componentPool().view(entry.getName().getLastNameSymbol()) == key;
+    }
+};
+struct FirstNameKey {
+    static constexpr bool hashCached = false;
+    static string key(const PhoneEntry& entry) { return entry.getFirstName(); }
+    static Symbol symbol(const PhoneEntry& entry) { return entry.getName().getFirstNameSymbol(); }
+    static bool matches(const PhoneEntry& entry, string_view key) {
+        return componentPool().view(entry.getName().getFirstNameSymbol()) == key;
+    }
+};
+struct FullNameKey {
+    static constexpr bool hashCached = true;
+    static string_view key(const PhoneEntry& entry) { return entry.getFullNameKey(); }
+    static uint64_t hash(const PhoneEntry& entry) { return entry.getFullNameHash(); }
+    static bool matches(const PhoneEntry& entry, string_view key) { return entry.getFullNameKey() == key; }
+};
+struct PhoneNumberKey {
+    static constexpr bool hashCached = false;
+    static string key(const PhoneEntry& entry) { return entry.getPhoneNumber(); }
+    static bool matches(const PhoneEntry& entry, string_view key) {
+        return componentPool().view(entry.getPhone().getSymbol()) == key;
+    }
+};
+
+// Groups entries by how their last name sounds
+struct LastNameSoundexKey {
+    static constexpr bool hashCached = false;
+    static SoundexCode key(const PhoneEntry& entry) { return soundex(componentPool().view(entry.getName().getLastNameSymbol())); }
+    static bool matches(const PhoneEntry& entry, string_view key) { return string_view(LastNameSoundexKey::key(entry)) == key; }
+};
+
+/**
+ * @class SecondaryIndex
+ * @details Maps one kind of key (last name, phone number, ...) to the ids of the entries that have it.
+ * Each distinct key gets one slot holding its posting list of EntryIds in insertion order, the key itself is not stored,
+ * it is read back from the EntryStore through the first id to confirm a match.
+ * @tparam KeyOf - One of the key structs above
+ */
+template <typename KeyOf>
+class SecondaryIndex {
+private:
+    using Postings = vector<EntryId>;
+
+    // The key's hash, read from the entry when it caches it
+    static uint64_t hashOf(const PhoneEntry& entry, StringHasher hasher) {
+        if constexpr (KeyOf::hashCached) {
+            return KeyOf::hash(entry);
+        } else {
+            return hasher(KeyOf::key(entry));
+        }
+    }
+
+    // Rehashes a posting list by looking its first entry up in the store
+    struct PostingsHash {
+        const EntryStore* store;
+        StringHasher hasher;
+        uint64_t operator()(const Postings& ids) const { return hashOf(store->get(ids.front()), hasher); }
+    };
+
+    const EntryStore& store;
+    StringHasher hasher;
+    FlatTable<Postings, PostingsHash> table;
+
+    auto matchKey(string_view key, uint64_t hashValue) const {
+        return [this, key, hashValue](const Postings& ids) {
+            const PhoneEntry& entry = store.get(ids.front());
+            if constexpr (KeyOf::hashCached) {
+                if (KeyOf::hash(entry) != hashValue) {
+                    return false;
+                }
+            }
+            return KeyOf::matches(entry, key);
+        };
+    }
+
+public:
+    SecondaryIndex(const EntryStore& entryStore, StringHasher hashPolicy)
+            : store(entryStore), hasher(hashPolicy), table(1, PostingsHash{&entryStore, hashPolicy}) {}
+
+    // Must be called while the entry is in the store
+    void add(EntryId id) {
+        const PhoneEntry& entry = store.get(id);
+        const auto& key = KeyOf::key(entry);
+        uint64_t hashValue = hashOf(entry, hasher);
+        Postings* ids = table.findFirst(hashValue, matchKey(key, hashValue));
+        if (ids != nullptr) {
+            ids->push_back(id);
+        } else {
+            table.insert(hashValue, Postings{id});
+        }
+    }
+    // Must be called before the entry is erased from the store
+    void remove(EntryId id) {
+        const PhoneEntry& entry = store.get(id);
+        const auto& key = KeyOf::key(entry);
+        uint64_t hashValue = hashOf(entry, hasher);
+        Postings* ids = table.findFirst(hashValue, matchKey(key, hashValue));
+        if (ids == nullptr) {
+            return;
+        }
+        if (ids->size() == 1 && ids->front() == id) {
+            // The slot goes while it still holds the id, a resize step in eraseFirst may rehash it through its first entry
+            table.eraseFirst(hashValue, [id](const Postings& other) { return other.size() == 1 && other.front() == id; });
+            return;
+        }
+        auto found = std::find(ids->begin(), ids->end(), id);
+        if (found != ids->end()) {
+            ids->erase(found);
+        }
+    }
+
+    // The entries whose key equals key, one probe and no allocation. probeLengths as FlatTable::findFirst
+    EntryRange lookup(string_view key, Histogram* probeLengths = nullptr) const {
+        uint64_t hashValue = hasher(key);
+        const Postings* ids = table.findFirst(hashValue, matchKey(key, hashValue), probeLengths);
+        if (ids == nullptr) {
+            return EntryRange();
+        }
+        return EntryRange(&store, ids->data(), ids->data() + ids->size());
+    }
+
+    void reserve(size_t keys) {
+        table.reserve(keys);
+    }
+
+    // Calls visit(first, last) with the posting list of every distinct key
+    template <typename Visit>
+    void forEachKey(Visit visit) const {
+        table.forEach([&visit](const Postings& ids) { visit(ids.data(), ids.data() + ids.size()); });
+    }
+
+    // Number of distinct keys
+    size_t size() const { return table.size(); }
+    size_t capacity() const { return table.capacity(); }
+    size_t longestProbe() const { return table.longestProbe(); }
+    size_t memoryUsed() const {
+        size_t bytes = table.memoryUsed();
+        table.forEach([&bytes](const Postings& ids) { bytes += ids.capacity() * sizeof(EntryId); });
+        return bytes;
+    }
+};
+
+/**
+ * @class PrefixIndex
+ * @details Search-as-you-type over the distinct keys of a SecondaryIndex, for the keys that are interned (last and
+ * first names). The keys are kept sorted as views into the StringPool so a prefix is one binary search and then a walk
+ * along the keys that start with it, the entries of each key come from the SecondaryIndex posting list.
+ * New keys go into a small sorted run first which is merged into the main run once it grows past sqrt(n), that keeps
+ * a single insert cheap without giving up the flat sorted array for lookups.
+ * @tparam KeyOf - LastNameKey or FirstNameKey
+ */
+template <typename KeyOf>
+class PrefixIndex {
+private:
+    const EntryStore& store;
+    const SecondaryIndex<KeyOf>& exact;
+    vector<string_view> sorted;
+    vector<string_view> recent;
+
+    static bool startsWith(string_view key, string_view prefix) {
+        return key.size() >= prefix.size() && key.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    void mergeRecent() {
+        vector<string_view> merged;
+        merged.reserve(sorted.size() + recent.size());
+        merge(sorted.begin(), sorted.end(), recent.begin(), recent.end(), back_inserter(merged));
+        sorted.swap(merged);
+        recent.clear();
+    }
+
+    static bool eraseKey(vector<string_view>& keys, string_view key) {
+        auto found = lower_bound(keys.begin(), keys.end(), key);
+        if (found == keys.end() || *found != key) {
+            return false;
+        }
+        keys.erase(found);
+        return true;
+    }
+
+public:
+    PrefixIndex(const EntryStore& entryStore, const SecondaryIndex<KeyOf>& exactIndex) : store(entryStore), exact(exactIndex) {}
+
+    // Must be called after the entry was added to the exact index, records the key if the entry is its first one
+    void add(EntryId id) {
+        string_view key = componentPool().view(KeyOf::symbol(store.get(id)));
+        if (exact.lookup(key).size() != 1) {
+            return;
+        }
+        recent.insert(upper_bound(recent.begin(), recent.end(), key), key);
+        if (recent.size() * recent.size() > max<size_t>(sorted.size(), 1024 * 1024)) {
+            mergeRecent();
+        }
+    }
+    // Adds the keys of a whole batch with one sort and merge, call it after the whole batch is in the exact index
+    void addBatch(const vector<EntryId>& ids) {
+        for (EntryId id : ids) {
+            string_view key = componentPool().view(KeyOf::symbol(store.get(id)));
+            // An older entry would be first in the posting list if the key was already here
+            if (exact.lookup(key).begin().id() == id) {
+                recent.push_back(key);
+            }
+        }
+        sort(recent.begin(), recent.end());
+        mergeRecent();
+    }
+    // Must be called after the entry was removed from the exact index, drops the key once nothing has it
+    void remove(EntryId id) {
+        string_view key = componentPool().view(KeyOf::symbol(store.get(id)));
+        if (!exact.lookup(key).empty()) {
+            return;
+        }
+        if (!eraseKey(recent, key)) {
+            eraseKey(sorted, key);
+        }
+    }
+
+    /**
+     * Up to k entries whose key starts with prefix, in key order and then insertion order within a key
+     * @param prefix - Already canonicalized the same way the keys are
+     * @param k - Most entries to return
+     */
+    vector<EntryId> complete(string_view prefix, size_t k) const {
+        vector<EntryId> ids;
+        auto fromSorted = lower_bound(sorted.begin(), sorted.end(), prefix);
+        auto fromRecent = lower_bound(recent.begin(), recent.end(), prefix);
+        while (ids.size() < k) {
+            bool sortedLeft = fromSorted != sorted.end() && startsWith(*fromSorted, prefix);
+            bool recentLeft = fromRecent != recent.end() && startsWith(*fromRecent, prefix);
+            if (!sortedLeft && !recentLeft) {
+                break;
+            }
+            string_view key = !recentLeft || (sortedLeft && *fromSorted < *fromRecent) ? *fromSorted++ : *fromRecent++;
+            EntryRange range = exact.lookup(key);
+            for (auto entry = range.begin(); entry != range.end() && ids.size() < k; ++entry) {
+                ids.push_back(entry.id());
+            }
+        }
+        return ids;
+    }
+
+    // Number of distinct keys
+    size_t size() const { return sorted.size() + recent.size(); }
+};
+
+/**
+ * @class FuzzyIndex
+ * @details Finds the keys within a small edit distance of a misspelled one without comparing against every key.
+ * It is a BK-tree over the distinct interned keys: every child sits at an exact edit distance from its parent, so by
+ * the triangle inequality a search for distance <= d from the query only has to follow the children whose distance
+ * is within d of the parent's. Children are kept as a first child / next sibling list in one array.
+ * Inserts only queue a new key, the next search puts the queued keys in the tree, so a load never pays for the edit
+ * distances of a tree nobody searches. A key whose last entry is removed stays in the tree and is skipped by searches
+ * (it is used again if the key comes back), once such keys are half the tree the next search rebuilds it without them.
+ * Searches may run at the same time, the one that finds work to do takes the tree lock exclusively to do it.
+ * @tparam KeyOf - LastNameKey or FirstNameKey
+ */
+template <typename KeyOf>
+class FuzzyIndex {
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Node {
+        string_view key;
+        uint32_t distance; // to the parent
+        uint32_t firstChild = none;
+        uint32_t nextSibling = none;
+    };
+
+    const EntryStore& store;
+    const SecondaryIndex<KeyOf>& exact;
+    mutable vector<Node> nodes;
+    mutable vector<string_view> pendingKeys; // first seen since the last search, not in the tree yet
+    mutable unordered_set<string_view> removedKeys; // keys that lost their last entry since the tree was last rebuilt
+    mutable shared_mutex treeLock;
+
+    void insertKey(string_view key) const {
+        if (nodes.empty()) {
+            nodes.push_back(Node{key, 0});
+            return;
+        }
+        uint32_t at = 0;
+        while (true) {
+            uint32_t distance = uint32_t(editDistance(key, nodes[at].key));
+            if (distance == 0) {
+                return; // already in the tree
+            }
+            uint32_t child = nodes[at].firstChild;
+            while (child != none && nodes[child].distance != distance) {
+                child = nodes[child].nextSibling;
+            }
+            if (child == none) {
+                nodes.push_back(Node{key, distance, none, nodes[at].firstChild});
+                nodes[at].firstChild = uint32_t(nodes.size() - 1);
+                return;
+            }
+            at = child;
+        }
+    }
+
+    // Puts the queued keys in the tree, or rebuilds it from the live keys once enough of them are gone
+    void update() const {
+        {
+            shared_lock<shared_mutex> reading(treeLock);
+            if (pendingKeys.empty() && removedKeys.size() * 2 <= nodes.size()) {
+                return;
+            }
+        }
+        unique_lock<shared_mutex> writing(treeLock);
+        if (removedKeys.size() * 2 > nodes.size()) {
+            for (const Node& node : nodes) pendingKeys.push_back(node.key);
+            nodes.clear();
+            removedKeys.clear();
+        }
+        for (string_view key : pendingKeys) {
+            if (!exact.lookup(key).empty()) {
+                insertKey(key);
+            }
+        }
+        pendingKeys.clear();
+    }
+
+public:
+    FuzzyIndex(const EntryStore& entryStore, const SecondaryIndex<KeyOf>& exactIndex) : store(entryStore), exact(exactIndex) {}
+
+    // Must be called after the entry was added to the exact index, the first entry of a key queues the key for the tree
+    // (a key that is back after losing its entries is already there and just stops counting as removed)
+    void add(EntryId id) {
+        string_view key = componentPool().view(KeyOf::symbol(store.get(id)));
+        if (exact.lookup(key).begin().id() == id) {
+            removedKeys.erase(key);
+            pendingKeys.push_back(key);
+        }
+    }
+    void addBatch(const vector<EntryId>& ids) {
+        for (EntryId id : ids) add(id);
+    }
+    // Must be called after the entry was removed from the exact index, counts the key as dead once nothing has it
+    void remove(EntryId id) {
+        string_view key = componentPool().view(KeyOf::symbol(store.get(id)));
+        if (exact.lookup(key).empty()) {
+            removedKeys.insert(key);
+        }
+    }
+
+    /**
+     * The entries whose key is at most maxDistance edits from key, closest first (then key order)
+     * @param key - Already canonicalized the same way the keys are
+     * @param maxDistance - Largest edit distance to accept, 1 or 2 is usual for typos
+     * @param k - Most entries to return
+     */
+    vector<EntryId> search(string_view key, size_t maxDistance, size_t k) const {
+        update();
+        shared_lock<shared_mutex> reading(treeLock);
+        vector<pair<size_t, string_view>> found;
+        vector<uint32_t> pending;
+        if (!nodes.empty()) pending.push_back(0);
+        while (!pending.empty()) {
+            const Node& node = nodes[pending.back()];
+            pending.pop_back();
+            size_t distance = editDistance(key, node.key);
+            if (distance <= maxDistance && !exact.lookup(node.key).empty()) {
+                found.emplace_back(distance, node.key);
+            }
+            for (uint32_t child = node.firstChild; child != none; child = nodes[child].nextSibling) {
+                if (nodes[child].distance + maxDistance >= distance && nodes[child].distance <= distance + maxDistance) {
+                    pending.push_back(child);
+                }
+            }
+        }
+        sort(found.begin(), found.end());
+        vector<EntryId> ids;
+        for (const auto& match : found) {
+            EntryRange range = exact.lookup(match.second);
+            for (auto entry = range.begin(); entry != range.end() && ids.size() < k; ++entry) {
+                ids.push_back(entry.id());
+            }
+        }
+        return ids;
+    }
+
+    // Number of keys in the tree or queued for it, including ones with no entries left
+    size_t size() const { return nodes.size() + pendingKeys.size(); }
+};
+
+/**
+ * @class BlockedBloomFilter
+ * @details A Bloom filter split into 64 byte blocks, every key sets all of its bits inside the one block its hash picks,
+ * so asking about a key reads a single cache line. It can say a key might be there when it is not (at about the rate it
+ * was sized for) but never misses a key that was added. Bits cannot be cleared, see PhoneKeyIndex for how removals are
+ * handled.
+ */
+class BlockedBloomFilter {
+private:
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+
+    vector<Block> blocks;
+    unsigned bitsPerKey; // how many bits each key sets in its block
+    size_t keyCapacity;
+
+    size_t blockIndex(uint64_t hash) const { return size_t((__uint128_t(hash) * blocks.size()) >> 64); }
+    Block& blockOf(uint64_t hash) { return blocks[blockIndex(hash)]; }
+    const Block& blockOf(uint64_t hash) const { return blocks[blockIndex(hash)]; }
+
+    // The bit positions come from a remix of the hash, so they do not follow the block choice
+    template <typename Visit>
+    void forEachBit(uint64_t hash, Visit visit) const {
+        uint64_t bits = (hash ^ (hash >> 29)) * 0xbf58476d1ce4e5b9ULL;
+        uint32_t position = uint32_t(bits), step = uint32_t(bits >> 32) | 1;
+        for (unsigned i = 0; i < bitsPerKey; i++, position += step) {
+            visit(position >> 23); // 0-511
+        }
+    }
+
+public:
+    /**
+     * @param expectedKeys - Keys it is sized for, past that the false positive rate climbs
+     * @param falsePositiveRate - Target chance that a key never added is reported as maybe there, e.g. 0.01
+     */
+    BlockedBloomFilter(size_t expectedKeys, double falsePositiveRate) : keyCapacity(max<size_t>(expectedKeys, 1)) {
+        double log2Rate = -log2(min(max(falsePositiveRate, 1e-9), 0.5));
+        bitsPerKey = unsigned(min(16.0, ceil(log2Rate)));
+        // 1.44 bits per key for each halving of the rate, plus a fifth for the uneven load on the blocks
+        double totalBits = double(keyCapacity) * log2Rate * 1.44 * 1.2;
+        blocks.assign(max<size_t>(1, size_t(ceil(totalBits / 512))), Block{});
+    }
+
+    void add(uint64_t hash) {
+        Block& block = blockOf(hash);
+        forEachBit(hash, [&block](uint32_t bit) { block.words[bit >> 6] |= uint64_t(1) << (bit & 63); });
+    }
+    bool mayContain(uint64_t hash) const {
+        const Block& block = blockOf(hash);
+        bool all = true;
+        forEachBit(hash, [&](uint32_t bit) { all &= (block.words[bit >> 6] >> (bit & 63)) & 1; });
+        return all;
+    }
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&blockOf(hash)); }
+
+    size_t capacity() const { return keyCapacity; }
+    size_t memoryUsed() const { return blocks.size() * sizeof(Block); }
+};
+
+/**
+ * @class PhoneKeyIndex
+ * @details The reverse index, packed phone key to the entries with that number. The key sits in the slot next to its
+ * posting list so a lookup is one integer hash and one probe that never touches a string or the EntryStore.
+ * Most numbers belong to one entry, that id is kept in the slot and a vector is only made for the second one.
+ * An optional BlockedBloomFilter answers most lookups of numbers that are not there from one cache line. Its bits
+ * cannot be taken back, so after as many removals as the keys it holds, or once it is over capacity, it is rebuilt
+ * from the table.
+ */
+class PhoneKeyIndex {
+private:
+    struct Bucket {
+        PhoneKey key;
+        EntryId single;
+        vector<EntryId> shared; // every id once there is more than one, empty before that
+
+        const EntryId* begin() const { return shared.empty() ? &single : shared.data(); }
+        const EntryId* end() const { return shared.empty() ? &single + 1 : shared.data() + shared.size(); }
+    };
+    struct BucketHash {
+        StringHasher hasher;
+        uint64_t operator()(const Bucket& bucket) const { return hasher(bucket.key); }
+    };
+
+    const EntryStore& store;
+    StringHasher hasher;
+    FlatTable<Bucket, BucketHash> table;
+    unique_ptr<BlockedBloomFilter> filter;
+    double filterRate = 0;
+    size_t staleKeys = 0; // removed keys still set in the filter
+
+    static auto matchKey(PhoneKey key) {
+        return [key](const Bucket& bucket) { return bucket.key == key; };
+    }
+
+    void rebuildFilter() {
+        filter = make_unique<BlockedBloomFilter>(max<size_t>(1024, table.size() + table.size() / 2), filterRate);
+        table.forEach([this](const Bucket& bucket) { filter->add(hasher(bucket.key)); });
+        staleKeys = 0;
+    }
+
+public:
+    PhoneKeyIndex(const EntryStore& entryStore, StringHasher hashPolicy)
+            : store(entryStore), hasher(hashPolicy), table(1, BucketHash{hashPolicy}) {}
+
+    void add(EntryId id) {
+        PhoneKey key = store.get(id).getPhone().getKey();
+        uint64_t hashValue = hasher(key);
+        Bucket* bucket = table.findFirst(hashValue, matchKey(key));
+        if (bucket == nullptr) {
+            table.insert(hashValue, Bucket{key, id, {}});
+            if (filter) {
+                filter->add(hashValue);
+                if (table.size() > filter->capacity()) rebuildFilter();
+            }
+        } else {
+            if (bucket->shared.empty()) bucket->shared.push_back(bucket->single);
+            bucket->shared.push_back(id);
+        }
+    }
+    void remove(EntryId id) {
+        PhoneKey key = store.get(id).getPhone().getKey();
+        uint64_t hashValue = hasher(key);
+        Bucket* bucket = table.findFirst(hashValue, matchKey(key));
+        if (bucket == nullptr) {
+            return;
+        }
+        if (bucket->shared.empty()) {
+            if (bucket->single == id) {
+                table.eraseFirst(hashValue, matchKey(key));
+                if (filter && ++staleKeys > table.size()) rebuildFilter();
+            }
+            return;
+        }
+        auto found = std::find(bucket->shared.begin(), bucket->shared.end(), id);
+        if (found == bucket->shared.end()) {
+            return;
+        }
+        bucket->shared.erase(found);
+        if (bucket->shared.size() == 1) {
+            bucket->single = bucket->shared.front();
+            vector<EntryId>().swap(bucket->shared);
+        }
+    }
+
+    /**
+     * Puts a Bloom filter in front of the table, or takes it away
+     * @param falsePositiveRate - How often a number that is not there may still go to the table, 0 removes the filter
+     */
+    void setFilter(double falsePositiveRate) {
+        filterRate = falsePositiveRate;
+        if (falsePositiveRate > 0) {
+            rebuildFilter();
+        } else {
+            filter.reset();
+        }
+    }
+    size_t filterMemory() const { return filter ? filter->memoryUsed() : 0; }
+
+    EntryRange lookup(PhoneKey key, Histogram* probeLengths = nullptr) const {
+        uint64_t hashValue = hasher(key);
+        if (filter && !filter->mayContain(hashValue)) {
+            return EntryRange();
+        }
+        const Bucket* bucket = table.findFirst(hashValue, matchKey(key), probeLengths);
+        if (bucket == nullptr) {
+            return EntryRange();
+        }
+        return EntryRange(&store, bucket->begin(), bucket->end());
+    }
+
+    /**
+     * Looks up count keys at once into out, hashing a block of keys first and then probing them through
+     * FlatTable::findBatch so their cache misses overlap instead of each lookup waiting on its own
+     * @param keys - The packed phone keys
+     * @param count - Number of keys
+     * @param out - Caller's array of count ranges, out[i] gets the entries of keys[i]
+     * @param probeLengths - As FlatTable::findFirst, keys the filter rules out read no groups and are not recorded
+     */
+    void lookupBatch(const PhoneKey* keys, size_t count, EntryRange* out, Histogram* probeLengths = nullptr) const {
+        const size_t blockSize = 256;
+        uint64_t hashes[blockSize];
+        size_t positions[blockSize]; // which key each hash belongs to, keys the filter rules out are left out
+        for (size_t start = 0; start < count; start += blockSize) {
+            size_t block = min(blockSize, count - start);
+            size_t probes = 0;
+            if (filter) {
+                for (size_t i = 0; i < block; i++) {
+                    hashes[i] = hasher(keys[start + i]);
+                    filter->prefetch(hashes[i]);
+                }
+                for (size_t i = 0; i < block; i++) {
+                    if (filter->mayContain(hashes[i])) {
+                        hashes[probes] = hashes[i];
+                        positions[probes++] = start + i;
+                    } else {
+                        out[start + i] = EntryRange();
+                    }
+                }
+            } else {
+                for (size_t i = 0; i < block; i++) {
+                    hashes[i] = hasher(keys[start + i]);
+                    positions[i] = start + i;
+                }
+                probes = block;
+            }
+            table.findBatch(hashes, probes,
+                            [keys, &positions](size_t i, const Bucket& bucket) { return bucket.key == keys[positions[i]]; },
+                            [this, out, &positions](size_t i, const Bucket* bucket) {
+                                out[positions[i]] = bucket == nullptr ? EntryRange() : EntryRange(&store, bucket->begin(), bucket->end());
+                            },
+                            probeLengths);
+        }
+    }
+
+    void reserve(size_t keys) {
+        table.reserve(keys);
+    }
+
+    // Calls visit(key, first, last) with the ids of every distinct phone number
+    template <typename Visit>
+    void forEachKey(Visit visit) const {
+        table.forEach([&visit](const Bucket& bucket) { visit(bucket.key, bucket.begin(), bucket.end()); });
+    }
+
+    // Number of distinct phone numbers
+    size_t size() const { return table.size(); }
+    size_t capacity() const { return table.capacity(); }
+    size_t longestProbe() const { return table.longestProbe(); }
+    size_t memoryUsed() const {
+        size_t bytes = table.memoryUsed() + filterMemory();
+        table.forEach([&bytes](const Bucket& bucket) { bytes += bucket.shared.capacity() * sizeof(EntryId); });
+        return bytes;
+    }
+};
+
+/**
+ * What a ColumnarStore scan keeps, every field that is set has to match. Build one with the helpers, e.g.
+ * ColumnFilter::inState("CA").withZipPrefix("94").
+ */
+struct ColumnFilter {
+    static constexpr Symbol noSymbol = UINT32_MAX; // matches no row, for a name or state that was never interned
+
+    optional<Symbol> lastName;
+    optional<Symbol> state;
+    uint32_t zipLow = 0, zipHigh = UINT32_MAX; // zip in [zipLow, zipHigh)
+
+    static Symbol symbolOf(string_view text) {
+        Symbol symbol;
+        return componentPool().find(text, symbol) ? symbol : noSymbol;
+    }
+    static ColumnFilter all() { return ColumnFilter(); }
+    static ColumnFilter inState(string_view stateName) { return all().withState(stateName); }
+    ColumnFilter withState(string_view stateName) const {
+        ColumnFilter filter = *this;
+        filter.state = symbolOf(stateName);
+        return filter;
+    }
+    ColumnFilter withLastName(string_view name) const {
+        ColumnFilter filter = *this;
+        filter.lastName = symbolOf(name);
+        return filter;
+    }
+    // The zips starting with these digits, as 5 digit zips, so "94" is 94000 to 94999. Anything but up to 5 digits
+    // matches no row, the same as a state that was never interned
+    ColumnFilter withZipPrefix(string_view digits) const {
+        ColumnFilter filter = *this;
+        if (digits.size() > 5 || !all_of(digits.begin(), digits.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+            filter.zipLow = filter.zipHigh = 0;
+            return filter;
+        }
+        uint32_t value = 0, scale = 100000;
+        for (char digit : digits) {
+            value = value * 10 + uint32_t(digit - '0');
+            scale /= 10;
+        }
+        filter.zipLow = value * scale;
+        filter.zipHigh = (value + 1) * scale;
+        return filter;
+    }
+};
+
+/**
+ * @class ColumnarStore
+ * @details The fields the scan queries filter on, each in its own array indexed by EntryId (struct of arrays), so a
+ * scan streams through just the columns it needs instead of whole PhoneEntry objects.
+ * The scan compares 4 rows per instruction with SSE2 and only touches the ids of the rows that matched.
+ * Rows of erased entries get a zip no range contains, so every scan skips them.
+ */
+class ColumnarStore {
+private:
+    static constexpr uint32_t deadZip = UINT32_MAX;
+    static constexpr uint32_t unknownZip = UINT32_MAX - 1; // zip not starting with 5 digits, only a scan of all zips has it
+
+    vector<uint32_t> lastNames;
+    vector<uint32_t> states;
+    vector<uint32_t> zips;
+    vector<PhoneKey> phones;
+
+    // The first 5 digits as a number (a ZIP+4 keeps its 5 digit zip), a zip that is shorter or not a number is
+    // unknownZip so no zip prefix matches it, e.g. "941" is not taken for 00941
+    static uint32_t zipValue(string_view zip) {
+        if (zip.size() < 5) {
+            return unknownZip;
+        }
+        uint32_t value = 0;
+        for (size_t i = 0; i < 5; i++) {
+            if (!isdigit(static_cast<unsigned char>(zip[i]))) {
+                return unknownZip;
+            }
+            value = value * 10 + uint32_t(zip[i] - '0');
+        }
+        return value;
+    }
+
+    // Bitmask of the rows in [row, row + 4) that pass, bit i for row + i
+    uint32_t matchFour(size_t row, const ColumnFilter& filter) const {
+#ifdef __SSE2__
+        // SSE2 only compares signed ints, flipping the top bit turns the unsigned order into the signed one
+        const __m128i flip = _mm_set1_epi32(int(0x80000000u));
+        __m128i zip = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&zips[row])), flip);
+        __m128i pass = _mm_cmplt_epi32(zip, _mm_set1_epi32(int(filter.zipHigh ^ 0x80000000u)));
+        if (filter.zipLow > 0) {
+            pass = _mm_and_si128(pass, _mm_cmpgt_epi32(zip, _mm_set1_epi32(int((filter.zipLow - 1) ^ 0x80000000u))));
+        }
+        if (filter.state) {
+            __m128i column = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&states[row]));
+            pass = _mm_and_si128(pass, _mm_cmpeq_epi32(column, _mm_set1_epi32(int(*filter.state))));
+        }
+        if (filter.lastName) {
+            __m128i column = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lastNames[row]));
+            pass = _mm_and_si128(pass, _mm_cmpeq_epi32(column, _mm_set1_epi32(int(*filter.lastName))));
+        }
+        return uint32_t(_mm_movemask_ps(_mm_castsi128_ps(pass)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < 4; i++) {
+            if (rowMatches(row + i, filter)) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    bool rowMatches(size_t row, const ColumnFilter& filter) const {
+        return zips[row] >= filter.zipLow && zips[row] < filter.zipHigh && (!filter.state || states[row] == *filter.state)
+               && (!filter.lastName || lastNames[row] == *filter.lastName);
+    }
+
+public:
+    // Adds or replaces the row of an entry
+    void add(EntryId id, const PhoneEntry& entry) {
+        if (id >= zips.size()) {
+            size_t rows = size_t(id) + 1;
+            lastNames.resize(rows, ColumnFilter::noSymbol);
+            states.resize(rows, ColumnFilter::noSymbol);
+            zips.resize(rows, deadZip);
+            phones.resize(rows, 0);
+        }
+        lastNames[id] = entry.getName().getLastNameSymbol();
+        states[id] = entry.getAddress().getState().getSymbol();
+        zips[id] = zipValue(componentPool().view(entry.getAddress().getZip().getSymbol()));
+        phones[id] = entry.getPhone().getKey();
+    }
+    void remove(EntryId id) {
+        zips[id] = deadZip;
+    }
+    void reserve(size_t rows) {
+        lastNames.reserve(rows);
+        states.reserve(rows);
+        zips.reserve(rows);
+        phones.reserve(rows);
+    }
+
+    /**
+     * The ids of the entries that pass the filter, in id order
+     * @param filter - See ColumnFilter
+     */
+    vector<EntryId> scan(const ColumnFilter& filter) const {
+        vector<EntryId> ids;
+        if (filter.zipLow >= filter.zipHigh) {
+            return ids;
+        }
+        size_t rows = zips.size();
+        size_t row = 0;
+        for (; row + 4 <= rows; row += 4) {
+            for (uint32_t mask = matchFour(row, filter); mask != 0; mask &= mask - 1) {
+                ids.push_back(EntryId(row + __builtin_ctz(mask)));
+            }
+        }
+        for (; row < rows; row++) {
+            if (rowMatches(row, filter)) ids.push_back(EntryId(row));
+        }
+        return ids;
+    }
+    // Number of entries that pass, without collecting them
+    size_t count(const ColumnFilter& filter) const {
+        if (filter.zipLow >= filter.zipHigh) {
+            return 0;
+        }
+        size_t rows = zips.size(), found = 0, row = 0;
+        for (; row + 4 <= rows; row += 4) found += size_t(__builtin_popcount(matchFour(row, filter)));
+        for (; row < rows; row++) found += rowMatches(row, filter);
+        return found;
+    }
+
+    PhoneKey phoneKey(EntryId id) const { return phones[id]; }
+    size_t rows() const { return zips.size(); }
+};
+
+/**
+ * The counters and histograms of one PhoneDirectory, only updated when DIRECTORY_STATS is on
+ */
+struct DirectoryCounters {
+    atomic<uint64_t> inserts{0}, lookups{0}, hits{0}, misses{0}, removes{0};
+    Histogram probeLength; // groups of the index read per lookup, only the find calls are counted
+    Histogram chainLength; // entries found per lookup
+    Histogram lookupNanos; // time per lookup, of a sample of them
+};
+
+// Size and shape of one index of a directory
+struct IndexStats {
+    string name;
+    size_t keys, capacity, longestProbe, bytes;
+
+    double loadFactor() const { return capacity == 0 ? 0 : double(keys) / double(capacity); }
+};
+
+/**
+ * @class PhoneDirectory
+ * @details One EntryStore with an index for each way the dictionaries look entries up.
+ * Dictionary and ReverseDictionary are both views of a PhoneDirectory, when they share one every entry is stored once
+ * and each lookup is a single probe into the matching index.
+ */
+class PhoneDirectory {
+private:
+    EntryStore store;
+    SecondaryIndex<LastNameKey> byLastName;
+    SecondaryIndex<FirstNameKey> byFirstName;
+    SecondaryIndex<FullNameKey> byFullName;
+    PhoneKeyIndex byPhoneNumber;
+
+    // The autocomplete, sounds-like and typo indexes, kept up to date together
+    struct NameSearch {
+        PrefixIndex<LastNameKey> lastNamePrefixes;
+        PrefixIndex<FirstNameKey> firstNamePrefixes;
+        SecondaryIndex<LastNameSoundexKey> byLastNameSound;
+        FuzzyIndex<LastNameKey> lastNameTypos;
+
+        NameSearch(const EntryStore& store, const SecondaryIndex<LastNameKey>& byLastName, const SecondaryIndex<FirstNameKey>& byFirstName)
+                : lastNamePrefixes(store, byLastName), firstNamePrefixes(store, byFirstName),
+                  byLastNameSound(store, store.getHasher()), lastNameTypos(store, byLastName) {}
+
+        // After the entry is in the exact indexes
+        void add(EntryId id) {
+            lastNamePrefixes.add(id);
+            firstNamePrefixes.add(id);
+            byLastNameSound.add(id);
+            lastNameTypos.add(id);
+        }
+        void addBatch(const vector<EntryId>& ids) {
+            lastNamePrefixes.addBatch(ids);
+            firstNamePrefixes.addBatch(ids);
+            for (EntryId id : ids) byLastNameSound.add(id);
+            lastNameTypos.addBatch(ids);
+        }
+        // After the entry left the exact indexes, while it is still in the store
+        void remove(EntryId id) {
+            lastNamePrefixes.remove(id);
+            firstNamePrefixes.remove(id);
+            byLastNameSound.remove(id);
+            lastNameTypos.remove(id);
+        }
+    };
+    unique_ptr<NameSearch> nameSearch; // only once enableNameSearch() is called
+    unique_ptr<ColumnarStore> columns; // only once enableColumns() is called
+    mutable DirectoryCounters counters;
+
+    static list<PhoneEntry> collect(const EntryRange& range) {
+        return list<PhoneEntry>(range.begin(), range.end());
+    }
+
+    void indexEntry(EntryId id) {
+        byLastName.add(id);
+        byFirstName.add(id);
+        byFullName.add(id);
+        byPhoneNumber.add(id);
+        if (nameSearch) nameSearch->add(id);
+        if (columns) columns->add(id, store.get(id));
+        DIRECTORY_STAT(bump(counters.inserts);)
+    }
+
+    // Counts a finished lookup, when DIRECTORY_STATS is on
+    void countLookup(const EntryRange& range) const {
+        bump(counters.lookups);
+        bump(range.empty() ? counters.misses : counters.hits);
+        counters.chainLength.record(range.size());
+    }
+    // Runs a lookup, counting it when DIRECTORY_STATS is on. Reading the clock costs more than a lookup so only
+    // one lookup in latencySampleRate is timed
+    template <typename Lookup>
+    EntryRange measured(Lookup lookup) const {
+#ifdef DIRECTORY_STATS
+        const uint32_t latencySampleRate = 64;
+        thread_local uint32_t untimed = 0;
+        if (++untimed < latencySampleRate) {
+            EntryRange range = lookup();
+            countLookup(range);
+            return range;
+        }
+        untimed = 0;
+        auto start = chrono::steady_clock::now();
+        EntryRange range = lookup();
+        counters.lookupNanos.record(uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()));
+        countLookup(range);
+        return range;
+#else
+        return lookup();
+#endif
+    }
+
+    // The name search indexes, query names the caller for the error when they are off
+    const NameSearch& searchIndexes(const char* query) const {
+        if (!nameSearch) {
+            throw runtime_error(string(query) + " needs enableNameSearch() first");
+        }
+        return *nameSearch;
+    }
+
+    EntryRange lookupPhoneNumber(string_view phoneNumber) const {
+        optional<PhoneKey> key = packPhoneNumber(phoneNumber);
+        if (!key) {
+            // Numbers that do not pack are keyed by their interned text, one that was never interned is not here
+            Symbol symbol;
+            if (!componentPool().find(phoneNumber, symbol)) {
+                return EntryRange();
+            }
+            key = phoneKeySymbolFlag | symbol;
+        }
+        return byPhoneNumber.lookup(*key, &counters.probeLength);
+    }
+
+public:
+    explicit PhoneDirectory(StringHasher hashPolicy = StringHasher())
+            : store(hashPolicy), byLastName(store, hashPolicy), byFirstName(store, hashPolicy),
+              byFullName(store, hashPolicy), byPhoneNumber(store, hashPolicy) {}
+
+    PhoneDirectory(const PhoneDirectory&) = delete;
+    PhoneDirectory& operator=(const PhoneDirectory&) = delete;
+
+    EntryId insert(PhoneEntry entry) {
+        EntryId id = store.add(std::move(entry));
+        indexEntry(id);
+        return id;
+    }
+
+    // Builds the entry directly in the store from the PhoneEntry constructor arguments
+    template <typename... Args>
+    EntryId emplace(Args&&... args) {
+        EntryId id = store.emplace(std::forward<Args>(args)...);
+        indexEntry(id);
+        return id;
+    }
+
+    /**
+     * Adds a batch of entries, the store first and then each index in turn so every pass stays in one table
+     * @param first, last - Range of PhoneEntry, moved from if they are move iterators
+     */
+    template <typename Iterator>
+    void insertBatch(Iterator first, Iterator last) {
+        vector<EntryId> ids;
+        ids.reserve(size_t(distance(first, last)));
+        for (; first != last; ++first) {
+            ids.push_back(store.add(*first));
+        }
+        for (EntryId id : ids) byLastName.add(id);
+        for (EntryId id : ids) byFirstName.add(id);
+        for (EntryId id : ids) byFullName.add(id);
+        for (EntryId id : ids) byPhoneNumber.add(id);
+        if (nameSearch) nameSearch->addBatch(ids);
+        if (columns) {
+            for (EntryId id : ids) columns->add(id, store.get(id));
+        }
+        DIRECTORY_STAT(bump(counters.inserts, ids.size());)
+    }
+
+    // Sizes the store and the per-entry indexes for n entries before a bulk load
+    void reserve(size_t n) {
+        store.reserve(n);
+        byFullName.reserve(n);
+        byPhoneNumber.reserve(n);
+    }
+
+    void erase(EntryId id) {
+        byLastName.remove(id);
+        byFirstName.remove(id);
+        byFullName.remove(id);
+        byPhoneNumber.remove(id);
+        if (nameSearch) nameSearch->remove(id);
+        if (columns) columns->remove(id);
+        store.erase(id);
+        DIRECTORY_STAT(bump(counters.removes);)
+    }
+
+    // Removes the first entry with this full name, returns false if there was none
+    bool removeByFullName(string_view fullName) {
+        EntryRange matches = byFullName.lookup(fullName);
+        if (matches.empty()) {
+            return false;
+        }
+        erase(matches.begin().id());
+        return true;
+    }
+
+    // Views of the matching entries
+    EntryRange findByLastName(string_view lastName) const {
+        return measured([&]() { return byLastName.lookup(lastName, &counters.probeLength); });
+    }
+    EntryRange findByFirstName(string_view firstName) const {
+        return measured([&]() { return byFirstName.lookup(firstName, &counters.probeLength); });
+    }
+    EntryRange findByFullName(string_view fullName) const {
+        return measured([&]() { return byFullName.lookup(fullName, &counters.probeLength); });
+    }
+    EntryRange findByPhoneNumber(string_view phoneNumber) const {
+        return measured([&]() { return lookupPhoneNumber(phoneNumber); });
+    }
+    EntryRange findByPhoneKey(PhoneKey key) const {
+        return measured([&]() { return byPhoneNumber.lookup(key, &counters.probeLength); });
+    }
+    // Batch versions, out[i] gets the entries of the i-th number, see PhoneKeyIndex::lookupBatch
+    void findByPhoneKeys(const PhoneKey* keys, size_t count, EntryRange* out) const {
+        DIRECTORY_STAT(auto start = chrono::steady_clock::now();)
+        byPhoneNumber.lookupBatch(keys, count, out, &counters.probeLength);
+        DIRECTORY_STAT(
+            // Each key is counted with the average time of the batch
+            uint64_t nanos = uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            for (size_t i = 0; i < count; i++) {
+                countLookup(out[i]);
+                counters.lookupNanos.record(nanos / max<size_t>(count, 1));
+            }
+        )
+    }
+    // Bloom filter in front of the phone index for lookups that mostly miss, 0 turns it off
+    void setPhoneFilter(double falsePositiveRate) { byPhoneNumber.setFilter(falsePositiveRate); }
+    size_t phoneFilterMemory() const { return byPhoneNumber.filterMemory(); }
+    void findByPhoneNumbers(const string_view* phoneNumbers, size_t count, EntryRange* out) const {
+        const size_t blockSize = 256;
+        PhoneKey keys[blockSize];
+        for (size_t start = 0; start < count; start += blockSize) {
+            size_t block = min(blockSize, count - start);
+            for (size_t i = 0; i < block; i++) {
+                optional<PhoneKey> key = packPhoneNumber(phoneNumbers[start + i]);
+                Symbol symbol;
+                if (!key && componentPool().find(phoneNumbers[start + i], symbol)) {
+                    key = phoneKeySymbolFlag | symbol;
+                }
+                // A number that was never interned gets the flag with all 32 symbol bits set. No entry has that key
+                // since the pool stops at 2^28 symbols, so UINT32_MAX is never a real one
+                keys[i] = key ? *key : phoneKeySymbolFlag | Symbol(UINT32_MAX);
+            }
+            findByPhoneKeys(keys, block, out + start);
+        }
+    }
+
+    /**
+     * Keeps the autocomplete, sounds-like and typo indexes from now on, for the name searches below. They are built
+     * here from the entries already in the directory, until then inserts and removes do not pay for them.
+     */
+    void enableNameSearch() {
+        if (nameSearch) {
+            return;
+        }
+        nameSearch = make_unique<NameSearch>(store, byLastName, byFirstName);
+        vector<EntryId> ids;
+        ids.reserve(store.size());
+        store.forEach([&ids](EntryId id, const PhoneEntry&) { ids.push_back(id); });
+        nameSearch->addBatch(ids);
+    }
+
+    /**
+     * Autocomplete, the ids of up to k entries whose last (or first) name starts with prefix, in name order.
+     * The prefix is formatted like the names are, so "smi" finds "Smith".
+     */
+    vector<EntryId> completeLastName(string_view prefix, size_t k) const {
+        return searchIndexes("completeLastName").lastNamePrefixes.complete(Name::canonicalPart(prefix), k);
+    }
+    vector<EntryId> completeFirstName(string_view prefix, size_t k) const {
+        return searchIndexes("completeFirstName").firstNamePrefixes.complete(Name::canonicalPart(prefix), k);
+    }
+
+    // Entries whose last name has the same Soundex code, e.g. Smith finds Smyth and Schmidt
+    EntryRange findByLastNameSound(string_view lastName) const {
+        return searchIndexes("findByLastNameSound").byLastNameSound.lookup(soundex(lastName));
+    }
+    // Ids of up to k entries whose last name is within maxDistance edits of lastName, closest first
+    vector<EntryId> findByLastNameTypo(string_view lastName, size_t maxDistance, size_t k) const {
+        return searchIndexes("findByLastNameTypo").lastNameTypos.search(Name::canonicalPart(lastName), maxDistance, k);
+    }
+
+    /**
+     * Keeps a columnar copy of the last name, state, zip and phone fields from now on, for scan()
+     */
+    void enableColumns() {
+        if (columns) {
+            return;
+        }
+        columns = make_unique<ColumnarStore>();
+        columns->reserve(store.size());
+        store.forEach([this](EntryId id, const PhoneEntry& entry) { columns->add(id, entry); });
+    }
+    // Ids of the entries that pass filter, e.g. scan(ColumnFilter::inState("CA").withZipPrefix("94"))
+    vector<EntryId> scan(const ColumnFilter& filter) const {
+        if (!columns) {
+            throw runtime_error("scan needs enableColumns() first");
+        }
+        return columns->scan(filter);
+    }
+    size_t countMatching(const ColumnFilter& filter) const {
+        if (!columns) {
+            throw runtime_error("countMatching needs enableColumns() first");
+        }
+        return columns->count(filter);
+    }
+
+    // Copies of the matching entries
+    list<PhoneEntry> fetchByLastName(string_view lastName) const { return collect(findByLastName(lastName)); }
+    list<PhoneEntry> fetchByFirstName(string_view firstName) const { return collect(findByFirstName(firstName)); }
+    list<PhoneEntry> fetchByFullName(string_view fullName) const { return collect(findByFullName(fullName)); }
+    list<PhoneEntry> fetchByPhoneNumber(string_view phoneNumber) const { return collect(findByPhoneNumber(phoneNumber)); }
+
+    const PhoneEntry& get(EntryId id) const { return store.get(id); }
+    const EntryStore& entries() const { return store; }
+    const SecondaryIndex<LastNameKey>& lastNameIndex() const { return byLastName; }
+    const SecondaryIndex<FirstNameKey>& firstNameIndex() const { return byFirstName; }
+    const SecondaryIndex<FullNameKey>& fullNameIndex() const { return byFullName; }
+    const PhoneKeyIndex& phoneIndex() const { return byPhoneNumber; }
+    size_t size() const { return store.size(); }
+
+    /**
+     * Instrumentation
+     * The counters and histograms only move when compiled with DIRECTORY_STATS, the index stats are always there
+     */
+    const DirectoryCounters& getCounters() const { return counters; }
+    vector<IndexStats> indexStats() const {
+        return {
+            IndexStats{"lastName", byLastName.size(), byLastName.capacity(), byLastName.longestProbe(), byLastName.memoryUsed()},
+            IndexStats{"firstName", byFirstName.size(), byFirstName.capacity(), byFirstName.longestProbe(), byFirstName.memoryUsed()},
+            IndexStats{"fullName", byFullName.size(), byFullName.capacity(), byFullName.longestProbe(), byFullName.memoryUsed()},
+            IndexStats{"phone", byPhoneNumber.size(), byPhoneNumber.capacity(), byPhoneNumber.longestProbe(), byPhoneNumber.memoryUsed()},
+        };
+    }
+    // Everything above as one JSON object
+    string statsJson() const {
+        auto number = [](const char* name, uint64_t value) { return string("\"") + name + "\":" + to_string(value); };
+        string json = "{\"statsEnabled\":" + string(directoryStatsEnabled ? "true" : "false") + "," + number("entries", size()) + ","
+                      + number("inserts", counters.inserts.load()) + "," + number("lookups", counters.lookups.load()) + ","
+                      + number("hits", counters.hits.load()) + "," + number("misses", counters.misses.load()) + ","
+                      + number("removes", counters.removes.load()) + ",\"probeLength\":" + counters.probeLength.toJson()
+                      + ",\"chainLength\":" + counters.chainLength.toJson() + ",\"lookupNanos\":" + counters.lookupNanos.toJson()
+                      + ",\"indexes\":{";
+        size_t indexBytes = 0;
+        vector<IndexStats> indexes = indexStats();
+        for (size_t i = 0; i < indexes.size(); i++) {
+            const IndexStats& index = indexes[i];
+            indexBytes += index.bytes;
+            json += (i > 0 ? ",\"" : "\"") + index.name + "\":{" + number("keys", index.keys) + "," + number("capacity", index.capacity)
+                    + ",\"loadFactor\":" + to_string(index.loadFactor()) + "," + number("longestProbe", index.longestProbe) + ","
+                    + number("bytes", index.bytes) + "}";
+        }
+        return json + "},\"memory\":{" + number("entries", store.memoryUsed()) + "," + number("indexes", indexBytes) + ","
+               + number("stringPool", componentPool().memoryUsed()) + "}}";
+    }
+
+    void getDisplayString() const {
+        cout << store.size() << " entries:" << endl;
+        store.forEach([](EntryId id, const PhoneEntry& entry) {
+            cout << "#" << id << " " << entry.getDisplayString() << endl;
+        });
+    }
+};
+
+// How many parts parallelFor splits count items into, 0 threads means one per core and no part gets under 4096 items
+unsigned parallelParts(size_t count, unsigned threads) {
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    return unsigned(min<size_t>(threads, max<size_t>(1, count / 4096)));
+}
+
+/**
+ * Runs work(part, begin, end) over [0, count) split evenly into parallelParts(count, threads) parts, one thread each.
+ * Part p covers lower items than part p + 1, so per part results joined in part order keep the item order.
+ */
+template <typename Work>
+void parallelForParts(size_t count, unsigned threads, Work work) {
+    unsigned parts = parallelParts(count, threads);
+    if (parts <= 1) {
+        work(0u, size_t(0), count);
+        return;
+    }
+    vector<thread> workers;
+    for (unsigned t = 0; t < parts; t++) {
+        workers.emplace_back([&work, count, parts, t]() { work(t, count * t / parts, count * (t + 1) / parts); });
+    }
+    for (thread& worker : workers) worker.join();
+}
+
+/**
+ * Runs work(begin, end) over [0, count) split evenly across threads, 0 threads means one per core
+ */
+template <typename Work>
+void parallelFor(size_t count, unsigned threads, Work work) {
+    parallelForParts(count, threads, [&work](unsigned, size_t begin, size_t end) { work(begin, end); });
+}
+
+/**
+ * @class MinimalPerfectHash
+ * @details Maps each of n distinct 64-bit key hashes to its own number in [0, n), BBHash style.
+ * Level 0 is a bit array of about gamma * n bits, every key hashes to one bit and the bits hit by exactly one key are
+ * kept set. The keys that collided try again in a smaller level 1 with another hash, and so on. A key's number is the
+ * count of set bits before its bit, read from a rank table of one count per 512 bits. With gamma 1 that is about
+ * 3 bits per key in total. A hash that was not in the build set still gets some number, callers check the key there.
+ * Equal hashes can't be told apart, they share one number and are listed in duplicateHashes().
+ */
+class MinimalPerfectHash {
+private:
+    static constexpr size_t maxLevels = 32;
+
+    vector<uint64_t> bits;       // every level one after the other
+    vector<uint64_t> ranks;      // set bits before each 8 word block
+    vector<size_t> levelStart;   // first bit of each level, plus the end
+    vector<pair<uint64_t, uint64_t>> leftovers; // (hash, number) of keys no level separated, sorted
+    vector<uint64_t> duplicates; // hashes given more than once, sorted
+    size_t keyCount = 0;
+
+    static uint64_t levelHash(uint64_t hash, size_t level) {
+        uint64_t mixed = (hash ^ (level * 0x9e3779b97f4a7c15ULL)) * 0xbf58476d1ce4e5b9ULL;
+        mixed ^= mixed >> 31;
+        return mixed * 0x94d049bb133111ebULL;
+    }
+    static size_t position(uint64_t hash, size_t level, size_t levelBits) {
+        return size_t((__uint128_t(levelHash(hash, level)) * levelBits) >> 64);
+    }
+    size_t rank(size_t bit) const {
+        size_t word = bit / 64;
+        uint64_t count = ranks[word / 8];
+        for (size_t w = word & ~size_t(7); w < word; w++) count += __builtin_popcountll(bits[w]);
+        return size_t(count + __builtin_popcountll(bits[word] & ((uint64_t(1) << (bit % 64)) - 1)));
+    }
+
+public:
+    MinimalPerfectHash() = default;
+
+    /**
+     * @param hashes - One hash per key, a hash given more than once counts as one key
+     * @param threads - Build threads, 0 for one per core
+     * @param gamma - Bits per remaining key in each level, more is a faster build and lookup but a bigger table
+     */
+    explicit MinimalPerfectHash(const vector<uint64_t>& hashes, unsigned threads = 0, double gamma = 1.0) : keyCount(hashes.size()) {
+        vector<uint64_t> remaining(hashes);
+        levelStart.push_back(0);
+        for (size_t level = 0; level < maxLevels && !remaining.empty(); level++) {
+            size_t levelBits = max<size_t>(64, size_t(ceil(double(remaining.size()) * gamma / 64)) * 64);
+            vector<atomic<uint64_t>> seen(levelBits / 64), collided(levelBits / 64);
+            parallelFor(remaining.size(), threads, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    size_t bit = position(remaining[i], level, levelBits);
+                    uint64_t mask = uint64_t(1) << (bit % 64);
+                    if (seen[bit / 64].fetch_or(mask, memory_order_relaxed) & mask) {
+                        collided[bit / 64].fetch_or(mask, memory_order_relaxed);
+                    }
+                }
+            });
+            // The keys that collided go on to the next level, each thread gathers the ones in its range into its own
+            // buffer and the buffers are joined in range order
+            vector<vector<uint64_t>> next(parallelParts(remaining.size(), threads));
+            parallelForParts(remaining.size(), threads, [&](unsigned part, size_t begin, size_t end) {
+                vector<uint64_t>& collisions = next[part];
+                for (size_t i = begin; i < end; i++) {
+                    size_t bit = position(remaining[i], level, levelBits);
+                    if (collided[bit / 64].load(memory_order_relaxed) & (uint64_t(1) << (bit % 64))) {
+                        collisions.push_back(remaining[i]);
+                    }
+                }
+            });
+            for (size_t w = 0; w < levelBits / 64; w++) {
+                bits.push_back(seen[w].load(memory_order_relaxed) & ~collided[w].load(memory_order_relaxed));
+            }
+            levelStart.push_back(levelStart.back() + levelBits);
+            remaining.clear();
+            for (const vector<uint64_t>& part : next) remaining.insert(remaining.end(), part.begin(), part.end());
+        }
+
+        bits.resize((bits.size() + 7) & ~size_t(7));
+        uint64_t count = 0;
+        for (size_t w = 0; w < bits.size(); w++) {
+            if (w % 8 == 0) ranks.push_back(count);
+            count += __builtin_popcountll(bits[w]);
+        }
+        // Whatever is still left (almost never anything) is numbered after the rest. Equal hashes collide on every
+        // level so they always end up here, and get one number between them
+        sort(remaining.begin(), remaining.end());
+        for (size_t i = 0; i < remaining.size(); i++) {
+            if (i > 0 && remaining[i] == remaining[i - 1]) {
+                if (duplicates.empty() || duplicates.back() != remaining[i]) duplicates.push_back(remaining[i]);
+                continue;
+            }
+            leftovers.emplace_back(remaining[i], count++);
+        }
+        keyCount = size_t(count);
+    }
+
+    // The key's number, in [0, size()) for any key that was in the build set
+    size_t operator()(uint64_t hash) const {
+        for (size_t level = 0; level + 1 < levelStart.size(); level++) {
+            size_t bit = levelStart[level] + position(hash, level, levelStart[level + 1] - levelStart[level]);
+            if ((bits[bit / 64] >> (bit % 64)) & 1) {
+                return rank(bit);
+            }
+        }
+        auto found = lower_bound(leftovers.begin(), leftovers.end(), make_pair(hash, uint64_t(0)));
+        return found != leftovers.end() && found->first == hash ? size_t(found->second) : 0;
+    }
+
+    size_t size() const { return keyCount; }
+    const vector<uint64_t>& duplicateHashes() const { return duplicates; }
+    double bitsPerKey() const {
+        size_t bytes = (bits.size() + ranks.size()) * sizeof(uint64_t) + leftovers.size() * sizeof(leftovers[0]);
+        return keyCount == 0 ? 0 : double(bytes) * 8 / double(keyCount);
+    }
+};
+
+/**
+ * @class FrozenDirectory
+ * @details A read-only copy of a PhoneDirectory's name and phone indexes, for deployments that are built once and
+ * then only read. Each index is a MinimalPerfectHash over its distinct key hashes plus one slot per hash, so a lookup
+ * is the hash, one slot read and one compare to make sure the key is really the one in the slot. Keys whose hash
+ * another key already has are kept in a sorted side list and compared one by one when the slot's key is not it.
+ * The entries themselves stay in the directory, which must not be changed after it is frozen.
+ */
+class FrozenDirectory {
+private:
+    struct Slot {
+        uint64_t key;         // the PhoneKey for phones, the key hash for names
+        uint32_t firstPosting;
+        uint32_t count;
+    };
+    // One frozen index, the slots are in MinimalPerfectHash order and the postings of all keys are back to back
+    struct Index {
+        MinimalPerfectHash hash;
+        vector<Slot> slots;
+        vector<EntryId> postings;
+        vector<pair<uint64_t, Slot>> collisions; // (hash, slot) of keys whose hash went to an earlier key, sorted by hash
+
+        // keys[i] (its hash, the slot key) owns ids[i]
+        void build(const vector<uint64_t>& hashes, const vector<uint64_t>& keys, const vector<vector<EntryId>>& ids, unsigned threads) {
+            hash = MinimalPerfectHash(hashes, threads);
+            slots.assign(hash.size(), Slot{0, 0, 0});
+            collisions.clear();
+            vector<uint32_t> offsets(ids.size() + 1, 0);
+            for (size_t i = 0; i < ids.size(); i++) offsets[i + 1] = offsets[i] + uint32_t(ids[i].size());
+            postings.resize(offsets.back());
+            const vector<uint64_t>& duplicates = hash.duplicateHashes();
+            auto shared = [&duplicates](uint64_t hashValue) {
+                return !duplicates.empty() && binary_search(duplicates.begin(), duplicates.end(), hashValue);
+            };
+            parallelFor(hashes.size(), threads, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (!shared(hashes[i])) slots[hash(hashes[i])] = Slot{keys[i], offsets[i], uint32_t(ids[i].size())};
+                    copy(ids[i].begin(), ids[i].end(), postings.begin() + offsets[i]);
+                }
+            });
+            // Of the keys sharing a hash the first takes the slot, in input order so the build is the same every time
+            for (size_t i = 0; i < hashes.size() && !duplicates.empty(); i++) {
+                if (!shared(hashes[i])) continue;
+                Slot& slot = slots[hash(hashes[i])];
+                Slot own{keys[i], offsets[i], uint32_t(ids[i].size())};
+                if (slot.count == 0) {
+                    slot = own;
+                } else {
+                    collisions.emplace_back(hashes[i], own);
+                }
+            }
+            stable_sort(collisions.begin(), collisions.end(),
+                        [](const pair<uint64_t, Slot>& a, const pair<uint64_t, Slot>& b) { return a.first < b.first; });
+        }
+        // The slot of hashValue's key that passes isKey(slot), or null
+        template <typename IsKey>
+        const Slot* find(uint64_t hashValue, IsKey isKey) const {
+            if (slots.empty()) {
+                return nullptr;
+            }
+            const Slot& slot = slots[hash(hashValue)];
+            if (slot.count != 0 && isKey(slot)) {
+                return &slot;
+            }
+            auto found = lower_bound(collisions.begin(), collisions.end(), hashValue,
+                                     [](const pair<uint64_t, Slot>& collision, uint64_t value) { return collision.first < value; });
+            for (; found != collisions.end() && found->first == hashValue; ++found) {
+                if (isKey(found->second)) return &found->second;
+            }
+            return nullptr;
+        }
+        size_t memoryUsed() const {
+            return size_t(hash.bitsPerKey() * double(hash.size()) / 8) + slots.size() * sizeof(Slot) + postings.size() * sizeof(EntryId)
+                   + collisions.size() * sizeof(collisions[0]);
+        }
+    };
+
+    shared_ptr<const PhoneDirectory> directory;
+    StringHasher hasher;
+    Index fullNames, lastNames, firstNames, phones;
+
+    template <typename KeyOf>
+    void freezeNames(Index& index, const SecondaryIndex<KeyOf>& source, unsigned threads) {
+        vector<uint64_t> hashes;
+        vector<vector<EntryId>> ids;
+        source.forEachKey([&](const EntryId* first, const EntryId* last) {
+            hashes.push_back(hasher(KeyOf::key(directory->get(*first))));
+            ids.emplace_back(first, last);
+        });
+        index.build(hashes, hashes, ids, threads);
+    }
+
+    template <typename KeyOf>
+    EntryRange lookupName(const Index& index, string_view key) const {
+        uint64_t hashValue = hasher(key);
+        const Slot* slot = index.find(hashValue, [&](const Slot& candidate) {
+            return candidate.key == hashValue && KeyOf::matches(directory->get(index.postings[candidate.firstPosting]), key);
+        });
+        if (slot == nullptr) {
+            return EntryRange();
+        }
+        const EntryId* first = index.postings.data() + slot->firstPosting;
+        return EntryRange(&directory->entries(), first, first + slot->count);
+    }
+
+public:
+    /**
+     * Builds the frozen indexes, in parallel
+     * @param source - The populated directory, e.g. dictionary.getDirectory(), it must not change from here on
+     * @param threads - Build threads, 0 for one per core
+     * The keys are hashed with the source directory's own hasher, so a seeded directory freezes the same way
+     */
+    explicit FrozenDirectory(shared_ptr<const PhoneDirectory> source, unsigned threads = 0)
+            : directory(std::move(source)), hasher(directory->entries().getHasher()) {
+        freezeNames(fullNames, directory->fullNameIndex(), threads);
+        freezeNames(lastNames, directory->lastNameIndex(), threads);
+        freezeNames(firstNames, directory->firstNameIndex(), threads);
+        vector<uint64_t> hashes, keys;
+        vector<vector<EntryId>> ids;
+        directory->phoneIndex().forEachKey([&](PhoneKey key, const EntryId* first, const EntryId* last) {
+            hashes.push_back(hasher(key));
+            keys.push_back(key);
+            ids.emplace_back(first, last);
+        });
+        phones.build(hashes, keys, ids, threads);
+    }
+
+    EntryRange findByFullName(string_view fullName) const { return lookupName<FullNameKey>(fullNames, fullName); }
+    EntryRange findByLastName(string_view lastName) const { return lookupName<LastNameKey>(lastNames, lastName); }
+    EntryRange findByFirstName(string_view firstName) const { return lookupName<FirstNameKey>(firstNames, firstName); }
+    EntryRange findByPhoneKey(PhoneKey key) const {
+        const Slot* slot = phones.find(hasher(key), [key](const Slot& candidate) { return candidate.key == key; });
+        if (slot == nullptr) {
+            return EntryRange();
+        }
+        const EntryId* first = phones.postings.data() + slot->firstPosting;
+        return EntryRange(&directory->entries(), first, first + slot->count);
+    }
+    EntryRange findByPhoneNumber(string_view phoneNumber) const {
+        optional<PhoneKey> key = packPhoneNumber(phoneNumber);
+        Symbol symbol;
+        if (!key && componentPool().find(phoneNumber, symbol)) {
+            key = phoneKeySymbolFlag | symbol;
+        }
+        return key ? findByPhoneKey(*key) : EntryRange();
+    }
+
+    size_t size() const { return directory->size(); }
+    // Bits per key of the perfect hash of the phone index, the slots and postings not counted
+    double phoneHashBitsPerKey() const { return phones.hash.bitsPerKey(); }
+    size_t memoryUsed() const { return fullNames.memoryUsed() + lastNames.memoryUsed() + firstNames.memoryUsed() + phones.memoryUsed(); }
+};
+
+class Dictionary {
+private:
+    shared_ptr<PhoneDirectory> directory;
+
+    list<PhoneEntry> collect(const vector<EntryId>& ids) const {
+        list<PhoneEntry> entries;
+        for (EntryId id : ids) {
+            entries.push_back(directory->get(id));
+        }
+        return entries;
+    }
+
+public:
+    /**
+     * @param hashPolicy - The hash used for the indexes, pass StringHasher::seeded() if the names come from outside
+     */
+    explicit Dictionary(StringHasher hashPolicy = StringHasher()) : directory(make_shared<PhoneDirectory>(hashPolicy)) {}
+    // Shares the entries with a ReverseDictionary or another Dictionary built on the same directory
+    explicit Dictionary(shared_ptr<PhoneDirectory> shared) : directory(std::move(shared)) {}
+
+    /**
+     * Insert function - Inserting a PhoneEntry object into the directory and each of its indexes.
+     * @param info - Represents the object which is being inserted into the dictionary, moved into the store
+     */
+    void insert(PhoneEntry info) {
+        directory->insert(std::move(info));
+    };
+    /**
+     * Emplace function - Same as insert but the PhoneEntry is constructed in place in the store
+     * @param args - The PhoneEntry constructor arguments (first, middle, last, street number, street, city, state, zip, phone)
+     */
+    template <typename... Args>
+    EntryId emplace(Args&&... args) {
+        return directory->emplace(std::forward<Args>(args)...);
+    }
+    /**
+     * Delete function - Deleting a PhoneEntry object from the dictionary based on the person's full name
+     * @param fullName - Represents the full name of the person to be removed
+     */
+    void remove(string_view fullName) {
+        directory->removeByFullName(fullName);
+    }
+
+    /**
+     * Find Methods
+     * Views of the matching entries, each is one probe into its own index and allocates nothing
+     */
+    EntryRange findByLastName(string_view lastName) const {
+        return directory->findByLastName(lastName);
+    }
+    EntryRange findByFirstName(string_view firstName) const {
+        return directory->findByFirstName(firstName);
+    }
+    EntryRange findByFullName(string_view fullName) const {
+        return directory->findByFullName(fullName);
+    }
+
+    /**
+     * Fetch Methods
+     * Different types of ways to fetch or search for a persons name, these return copies of the entries
+     */
+    list<PhoneEntry> fetchByLastName(string_view lastName) {
+        return directory->fetchByLastName(lastName);
+    }
+    list<PhoneEntry> fetchByFirstName(string_view firstName) {
+        return directory->fetchByFirstName(firstName);
+    }
+    list<PhoneEntry> fetchByFullName(string_view fullName) {
+        return directory->fetchByFullName(fullName);
+    }
+
+    /**
+     * Autocomplete Method
+     * Up to k entries whose last name starts with prefix, for search-as-you-type
+     * Needs getDirectory()->enableNameSearch() first, as do the fuzzy methods
+     * @param prefix - What has been typed so far, any case
+     * @param k - Most entries to return
+     */
+    list<PhoneEntry> autocompleteLastName(string_view prefix, size_t k) const {
+        return collect(directory->completeLastName(prefix, k));
+    }
+
+    /**
+     * Fuzzy Methods
+     * For last names that may be misspelled, by how they sound or by a few typed characters being wrong
+     * @param lastName - The last name as it was given
+     * @param maxDistance - Most single character edits away a match may be
+     */
+    list<PhoneEntry> fetchBySoundsLike(string_view lastName) const {
+        const EntryRange matches = directory->findByLastNameSound(lastName);
+        return list<PhoneEntry>(matches.begin(), matches.end());
+    }
+    list<PhoneEntry> fetchByLastNameTypo(string_view lastName, size_t maxDistance = 2, size_t k = 20) const {
+        return collect(directory->findByLastNameTypo(lastName, maxDistance, k));
+    }
+
+    size_t size() const { return directory->size(); }
+    shared_ptr<PhoneDirectory> getDirectory() const { return directory; }
+    /**
+     * Read-only version of the name lookups on a minimal perfect hash, once no more entries will be added
+     * @param threads - Build threads, 0 for one per core
+     */
+    FrozenDirectory freeze(unsigned threads = 0) const {
+        return FrozenDirectory(directory, threads);
+    }
+
+    /**
+     * Instrumentation of the directory, counts and histograms need DIRECTORY_STATS, see PhoneDirectory::statsJson
+     */
+    const DirectoryCounters& getCounters() const { return directory->getCounters(); }
+    string getStatsJson() const { return directory->statsJson(); }
+
+    // getDisplayString method shows every entry in the directory
+    void getDisplayString() const {
+        directory->getDisplayString();
+    }
+};
+
+// Essentially the opposite of the Dictionary class but has a lot of similarities
+class ReverseDictionary {
+private:
+    shared_ptr<PhoneDirectory> directory;
+
+public:
+    explicit ReverseDictionary(StringHasher hashPolicy = StringHasher()) : directory(make_shared<PhoneDirectory>(hashPolicy)) {}
+    // Reverse lookups into the same entries as a Dictionary, e.g. ReverseDictionary(dictionary.getDirectory())
+    explicit ReverseDictionary(shared_ptr<PhoneDirectory> shared) : directory(std::move(shared)) {}
+
+    // Similar to the Dictionary class's insert, emplace, search, and display
+    void insert(PhoneEntry entry) {
+        directory->insert(std::move(entry));
+    }
+    template <typename... Args>
+    EntryId emplace(Args&&... args) {
+        return directory->emplace(std::forward<Args>(args)...);
+    }
+
+    // View of the phone entries with this phone number, allocates nothing
+    EntryRange findByPhoneNumber(string_view phoneNumber) const {
+        return directory->findByPhoneNumber(phoneNumber);
+    }
+    // Same as findByPhoneNumber for a number that was packed already, a single integer probe
+    EntryRange findByPhoneKey(PhoneKey key) const {
+        return directory->findByPhoneKey(key);
+    }
+    /**
+     * Batch lookup, for jobs that resolve many numbers at once. Much faster than calling findByPhoneNumber in a loop
+     * since the memory reads of the different numbers overlap.
+     * @param phoneNumbers - The numbers to look up
+     * @param count - How many there are
+     * @param out - Caller's array of count ranges, out[i] gets the entries with phoneNumbers[i]
+     */
+    void findByPhoneNumbers(const string_view* phoneNumbers, size_t count, EntryRange* out) const {
+        directory->findByPhoneNumbers(phoneNumbers, count, out);
+    }
+    void findByPhoneKeys(const PhoneKey* keys, size_t count, EntryRange* out) const {
+        directory->findByPhoneKeys(keys, count, out);
+    }
+    /**
+     * Turns on a Bloom filter that answers lookups of numbers not in the directory without probing the index,
+     * worth it when most lookups miss
+     * @param falsePositiveRate - Share of those misses that still probe the index, e.g. 0.01; 0 turns the filter off
+     */
+    void enableMissFilter(double falsePositiveRate) {
+        directory->setPhoneFilter(falsePositiveRate);
+    }
+    // Search for phone entries by phone number, returns copies
+    list<PhoneEntry> searchByPhoneNumber(string_view phoneNumber) const {
+        return directory->fetchByPhoneNumber(phoneNumber);
+    }
+
+    size_t size() const { return directory->size(); }
+    shared_ptr<PhoneDirectory> getDirectory() const { return directory; }
+    // Read-only version of the reverse lookups on a minimal perfect hash, see Dictionary::freeze
+    FrozenDirectory freeze(unsigned threads = 0) const {
+        return FrozenDirectory(directory, threads);
+    }
+    // Instrumentation, see Dictionary::getStatsJson
+    const DirectoryCounters& getCounters() const { return directory->getCounters(); }
+    string getStatsJson() const { return directory->statsJson(); }
+
+    // Display reverse phone directory entries
+    void getDisplayString() const {
+        directory->getDisplayString();
+    }
+};
+
+/**
+ * @class MappedFile
+ * @details Read-only view of a whole file. On POSIX systems the file is mmap'd so the page cache is read directly,
+ * anywhere else it is read into memory once.
+ */
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    vector<char> buffer;
+
+public:
+    /**
+     * @param path - The file to map
+     * @param sequential - Read ahead for one pass from start to end, otherwise tell the kernel the reads are random
+     */
+    explicit MappedFile(const string& path, bool sequential = true) {
+#if defined(__unix__) || defined(__APPLE__)
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw runtime_error("Failed to open " + path);
+        }
+        struct stat info {};
+        fstat(descriptor, &info);
+        length = size_t(info.st_size);
+        if (length > 0) {
+            void* memory = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (memory != MAP_FAILED) {
+                madvise(memory, length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                bytes = static_cast<const char*>(memory);
+                mapped = true;
+            }
+        }
+        close(descriptor);
+        if (mapped || length == 0) {
+            return;
+        }
+#endif
+        ifstream file(path, ios::binary);
+        if (!file) {
+            throw runtime_error("Failed to open " + path);
+        }
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        bytes = buffer.data();
+        length = buffer.size();
+    }
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped) munmap(const_cast<char*>(bytes), length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view contents() const { return string_view(bytes, length); }
+};
+
+// What loadDirectoryCsv did
+struct CsvLoadResult {
+    size_t rows = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+};
+
+/**
+ * Splits one CSV line into fields, as views into the line. A field in double quotes may contain commas,
+ * the quotes are dropped (a doubled "" inside is left as it is).
+ * @return The number of fields, at most maxFields are stored
+ */
+size_t splitCsvLine(string_view line, string_view* fields, size_t maxFields) {
+    size_t count = 0;
+    size_t position = 0;
+    while (true) {
+        string_view field;
+        if (position < line.size() && line[position] == '"') {
+            size_t closing = line.find('"', position + 1);
+            while (closing != string_view::npos && closing + 1 < line.size() && line[closing + 1] == '"') {
+                closing = line.find('"', closing + 2);
+            }
+            if (closing == string_view::npos) closing = line.size();
+            field = line.substr(position + 1, closing - position - 1);
+            position = min(line.size(), closing + 1);
+        } else {
+            size_t comma = line.find(',', position);
+            field = line.substr(position, (comma == string_view::npos ? line.size() : comma) - position);
+            position += field.size();
+        }
+        if (count < maxFields) fields[count] = field;
+        count++;
+        if (position >= line.size()) return count;
+        position++; // the comma
+    }
+}
+
+/**
+ * @class CsvStringTable
+ * @details The distinct strings one loadDirectoryCsv thread has seen, numbered in the order they first showed up.
+ * Rows are kept as these numbers, so the StringPool only hears about each distinct string once, in a single
+ * internBatch call after all the threads are done, instead of every field of every row taking the pool's lock.
+ * The texts are views into the mapped file, except name parts whose case had to change, those are copied into
+ * the table's own blocks.
+ */
+class CsvStringTable {
+private:
+    static constexpr size_t blockSize = 16 * 1024;
+
+    // Hashes are kept next to the texts, so growing the table does not hash them again
+    struct IdHash {
+        const vector<uint64_t>* hashes;
+        uint64_t operator()(uint32_t id) const { return (*hashes)[id]; }
+    };
+
+    vector<string_view> texts;
+    vector<uint64_t> hashes;
+    FlatTable<uint32_t, IdHash> lookup;
+    vector<unique_ptr<char[]>> blocks;
+    size_t blockUsed = blockSize;
+
+    const uint32_t* find(string_view text, uint64_t hashValue) const {
+        return lookup.findFirst(hashValue, [this, text](uint32_t id) { return texts[id] == text; });
+    }
+    uint32_t append(string_view text, uint64_t hashValue) {
+        uint32_t id = uint32_t(texts.size());
+        texts.push_back(text);
+        hashes.push_back(hashValue);
+        lookup.insert(hashValue, id);
+        return id;
+    }
+
+    // The number of text, copied into the table's blocks if it is new, so text may be a temporary
+    uint32_t addCopy(string_view text) {
+        uint64_t hashValue = StringHasher()(text);
+        if (const uint32_t* found = find(text, hashValue)) {
+            return *found;
+        }
+        char* destination;
+        if (text.size() > blockSize) {
+            unique_ptr<char[]> block(new char[text.size()]);
+            destination = block.get();
+            // In front of the current block, so later strings keep filling that one
+            blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, std::move(block));
+        } else {
+            if (blockUsed + text.size() > blockSize) {
+                blocks.emplace_back(new char[blockSize]);
+                blockUsed = 0;
+            }
+            destination = blocks.back().get() + blockUsed;
+            blockUsed += text.size();
+        }
+        memcpy(destination, text.data(), text.size());
+        return append(string_view(destination, text.size()), hashValue);
+    }
+
+public:
+    CsvStringTable() : lookup(1, IdHash{&hashes}) {}
+    CsvStringTable(const CsvStringTable&) = delete;
+    CsvStringTable& operator=(const CsvStringTable&) = delete;
+
+    // The number of text, the caller keeps the viewed bytes alive until the table is interned
+    uint32_t add(string_view text) {
+        uint64_t hashValue = StringHasher()(text);
+        const uint32_t* found = find(text, hashValue);
+        return found != nullptr ? *found : append(text, hashValue);
+    }
+
+    // The number of a name part in its canonical form, see Name::canonicalPart
+    uint32_t addNamePart(string_view text) {
+        string_view part = Name::trimPart(text);
+        if (Name::isCanonical(part)) {
+            return add(part);
+        }
+        char recased[256];
+        if (part.size() <= sizeof(recased)) {
+            Name::writeCanonical(part, recased);
+            return addCopy(string_view(recased, part.size()));
+        }
+        string longPart(part);
+        Name::writeCanonical(part, &longPart[0]);
+        return addCopy(longPart);
+    }
+
+    // The number of the full name last + middle + first, three numbers from addNamePart, see Name::getName
+    uint32_t addFullName(uint32_t last, uint32_t middle, uint32_t first) {
+        string_view parts[3] = {texts[last], texts[middle], texts[first]};
+        char joined[256];
+        if (parts[0].size() + parts[1].size() + parts[2].size() <= sizeof(joined)) {
+            size_t length = 0;
+            for (string_view part : parts) {
+                part.copy(joined + length, part.size()); // not memcpy, an empty field may have no data pointer
+                length += part.size();
+            }
+            return addCopy(string_view(joined, length));
+        }
+        return addCopy(string(parts[0]).append(parts[1]).append(parts[2]));
+    }
+
+    size_t size() const { return texts.size(); }
+    const vector<string_view>& getTexts() const { return texts; }
+    const vector<uint64_t>& getHashes() const { return hashes; }
+};
+
+/**
+ * Bulk loads a CSV file into a PhoneDirectory.
+ * The header row says which column is which: FIRST NAME, MIDDLE NAME, LAST NAME, STREET NUM, STREET, CITY, STATE, ZIP
+ * and PHONE are used, anything else (ID, EMPLOYER, ...) is skipped and missing ones are left empty.
+ *  1. The file is memory mapped and cut into one line-aligned chunk per thread
+ *  2. The threads parse their chunks in parallel. The fields are string_views into the mapping, each thread numbers
+ *     the distinct ones and the full names made from them in its own CsvStringTable, every row is ten of those numbers
+ *  3. All the threads' strings are interned in one StringPool::internBatch, a single lock acquisition for the load
+ *  4. The threads turn their rows into PhoneEntry objects from the symbols, which needs no lock at all
+ *  5. The directory is reserved for all the rows and they are inserted in batches, in file order
+ * Quoted fields with line breaks in them are not supported.
+ * @param directory - Where the entries go
+ * @param path - The CSV file, e.g. personRelation.csv from Project 6
+ * @param threads - Number of parser threads, 0 uses one per core
+ * @param batchSize - Rows per insertBatch call
+ */
+CsvLoadResult loadDirectoryCsv(PhoneDirectory& directory, const string& path, unsigned threads = 0, size_t batchSize = 65536) {
+    auto start = chrono::high_resolution_clock::now();
+    MappedFile file(path);
+    string_view data = file.contents();
+
+    // Match the header columns to the PhoneEntry fields
+    const char* fieldNames[] = {"FIRST NAME", "MIDDLE NAME", "LAST NAME", "STREET NUM", "STREET", "CITY", "STATE", "ZIP", "PHONE"};
+    const size_t fieldCount = sizeof(fieldNames) / sizeof(fieldNames[0]);
+    const size_t maxColumns = 64;
+    size_t headerEnd = min(data.find('\n'), data.size());
+    string_view header[maxColumns];
+    size_t columns = min(maxColumns, splitCsvLine(data.substr(0, headerEnd), header, maxColumns));
+    int columnOf[fieldCount];
+    for (size_t field = 0; field < fieldCount; field++) {
+        columnOf[field] = -1;
+        for (size_t column = 0; column < columns; column++) {
+            string_view name = header[column];
+            while (!name.empty() && isspace(static_cast<unsigned char>(name.back()))) name.remove_suffix(1);
+            if (name.size() == strlen(fieldNames[field])
+                && equal(name.begin(), name.end(), fieldNames[field], [](char a, char b) { return toupper(a) == b; })) {
+                columnOf[field] = int(column);
+            }
+        }
+    }
+    string_view body = data.substr(min(data.size(), headerEnd + 1));
+
+    // Line-aligned chunks, one per thread
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    vector<size_t> bounds{0};
+    for (unsigned i = 1; i < threads; i++) {
+        size_t cut = max(bounds.back(), body.size() * i / threads);
+        cut = body.find('\n', cut);
+        bounds.push_back(cut == string_view::npos ? body.size() : cut + 1);
+    }
+    bounds.push_back(body.size());
+
+    typedef array<uint32_t, fieldCount + 1> Row; // numbers in the thread's CsvStringTable, the full name last
+    vector<unique_ptr<CsvStringTable>> strings(threads);
+    vector<vector<Row>> rows(threads);
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            string_view chunk = body.substr(bounds[t], bounds[t + 1] - bounds[t]);
+            strings[t].reset(new CsvStringTable());
+            CsvStringTable& table = *strings[t];
+            rows[t].reserve(count(chunk.begin(), chunk.end(), '\n') + 1);
+            string_view fields[maxColumns];
+            string_view empty;
+            while (!chunk.empty()) {
+                size_t lineEnd = min(chunk.find('\n'), chunk.size());
+                string_view line = chunk.substr(0, lineEnd);
+                chunk.remove_prefix(min(chunk.size(), lineEnd + 1));
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (line.empty()) continue;
+
+                size_t found = min(maxColumns, splitCsvLine(line, fields, maxColumns));
+                auto field = [&](size_t which) -> string_view {
+                    int column = columnOf[which];
+                    return column >= 0 && size_t(column) < found ? fields[column] : empty;
+                };
+                Row row;
+                for (size_t which = 0; which < fieldCount; which++) {
+                    // The first three are the name parts
+                    row[which] = which < 3 ? table.addNamePart(field(which)) : table.add(field(which));
+                }
+                row[fieldCount] = table.addFullName(row[2], row[1], row[0]);
+                rows[t].push_back(row);
+            }
+        });
+    }
+    for (thread& worker : workers) worker.join();
+    workers.clear();
+
+    // Every thread's strings in one go, symbols[offsets[t] + n] is string n of thread t
+    vector<size_t> offsets{0};
+    for (unsigned t = 0; t < threads; t++) offsets.push_back(offsets.back() + strings[t]->size());
+    vector<string_view> texts;
+    vector<uint64_t> hashes;
+    texts.reserve(offsets.back());
+    hashes.reserve(offsets.back());
+    for (unsigned t = 0; t < threads; t++) {
+        texts.insert(texts.end(), strings[t]->getTexts().begin(), strings[t]->getTexts().end());
+        hashes.insert(hashes.end(), strings[t]->getHashes().begin(), strings[t]->getHashes().end());
+    }
+    vector<Symbol> symbols(offsets.back());
+    componentPool().internBatch(texts.data(), hashes.data(), texts.size(), symbols.data());
+    emptySymbol();
+
+    vector<vector<PhoneEntry>> parsed(threads);
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            const Symbol* local = symbols.data() + offsets[t];
+            parsed[t].reserve(rows[t].size());
+            for (const Row& row : rows[t]) {
+                PhoneEntry::Parts parts{local[row[0]], local[row[1]], local[row[2]], local[row[3]], local[row[4]],
+                                        local[row[5]], local[row[6]], local[row[7]], local[row[8]], local[row[9]]};
+                parsed[t].emplace_back(parts);
+            }
+            vector<Row>().swap(rows[t]);
+            strings[t].reset();
+        });
+    }
+    for (thread& worker : workers) worker.join();
+
+    CsvLoadResult result;
+    for (const vector<PhoneEntry>& entries : parsed) result.rows += entries.size();
+    directory.reserve(directory.size() + result.rows);
+    for (vector<PhoneEntry>& entries : parsed) {
+        for (size_t first = 0; first < entries.size(); first += batchSize) {
+            size_t last = min(entries.size(), first + batchSize);
+            directory.insertBatch(make_move_iterator(entries.begin() + first), make_move_iterator(entries.begin() + last));
+        }
+        vector<PhoneEntry>().swap(entries);
+    }
+
+    result.bytes = data.size();
+    result.seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    return result;
+}
+
+/**
+ * @class DirectorySnapshot
+ * @details A PhoneDirectory saved to a binary file that is used straight from an mmap, nothing is parsed or rebuilt
+ * when it is opened so startup only costs the header check, and processes that open the same file share its pages.
+ * File layout (native byte order, every section starts 8 byte aligned):
+ *  Header          magic, format version, byte order mark, hash seed, counts and where each section starts
+ *  String offsets  stringCount + 1 uint64, string i is the bytes [offset[i], offset[i + 1])
+ *  String bytes    every component string the entries use, once each
+ *  Entry table     one Record per entry, its components as string numbers plus the packed phone key
+ *  Indexes         last name, first name, full name and phone. Each is a power of two open addressing table of
+ *                  Slot {hash of the key (the PhoneKey itself for phones), first posting, posting count} followed
+ *                  by the postings, entry numbers grouped by key
+ * The version goes up whenever the layout changes, an older or newer file is refused rather than misread.
+ */
+class DirectorySnapshot {
+public:
+    static constexpr uint32_t currentVersion = 2;
+    enum IndexKind { LastNameIndex, FirstNameIndex, FullNameIndex, PhoneIndex, indexKinds };
+
+    struct Record {
+        uint32_t first, middle, last, streetNum, street, city, state, zip, country, area, number, unused;
+        uint64_t phoneKey;
+    };
+    struct Slot {
+        uint64_t key;
+        uint32_t firstPosting;
+        uint32_t count; // 0 for an empty slot
+    };
+    struct IndexSection {
+        uint64_t slotsOffset, slotCount, postingsOffset, postingCount;
+    };
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t fileSize;
+        uint64_t hashSeed;
+        uint64_t stringCount, stringOffsetsOffset, stringBytesOffset;
+        uint64_t entryCount, entriesOffset;
+        IndexSection indexes[indexKinds];
+    };
+
+private:
+    static constexpr char magicBytes[8] = {'P', 'J', '2', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr uint32_t byteOrderMark = 0x01020304;
+
+    MappedFile file;
+    Header header;
+    StringHasher hasher;
+    const uint64_t* stringOffsets;
+    const char* stringBytes;
+    const Record* records;
+    const Slot* slots[indexKinds];
+    uint64_t stringBytesSize; // checked against the file when it was opened
+    const uint32_t* postings[indexKinds];
+
+    // Phones that did not pack are keyed by the hash of their text with the flag bit set, like PhoneKey does with Symbols
+    static uint64_t phoneSlotKey(PhoneKey packed, bool isPacked, StringHasher hasher, string_view text) {
+        return isPacked ? packed : phoneKeySymbolFlag | hasher(text);
+    }
+
+    template <typename T>
+    const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(file.contents().data() + offset); }
+
+    // Throws unless count T's from offset are inside the file past the header, starting 8 byte aligned like write() puts them
+    template <typename T>
+    void checkSection(const string& path, const char* section, uint64_t offset, uint64_t count) const {
+        uint64_t size = header.fileSize;
+        if (offset % 8 != 0 || offset < sizeof(Header) || offset > size || count > (size - offset) / sizeof(T)) {
+            throw runtime_error(path + " is corrupt, its " + section + " are out of bounds");
+        }
+    }
 
 public:
     /**
-     * Insert function - Inserting a PhoneEntry object into the appropriate bucket in the dictionary.
-     * @param info - Represents the object which is being inserted into the dictionary
+     * @class EntryView
+     * @details One entry of the snapshot, read in place. The getters match PhoneEntry's.
      */
-    void insert(PhoneEntry info) {
-        int bucketIndex = hash(info.getFullName());
-        buckets[bucketIndex].push_back(info);
+    class EntryView {
+    private:
+        const DirectorySnapshot* snapshot;
+        const Record* record;
+    public:
+        EntryView(const DirectorySnapshot* owner, const Record* entry) : snapshot(owner), record(entry) {}
+
+        string_view lastName() const { return snapshot->text(record->last); }
+        string_view firstName() const { return snapshot->text(record->first); }
+        string_view middleName() const { return snapshot->text(record->middle); }
+        string_view phoneNumber() const { return snapshot->text(record->number); }
+        PhoneKey getPhoneKey() const { return record->phoneKey; }
+        const Record* getRecord() const { return record; }
+
+        string getLastName() const { return string(lastName()); }
+        string getFirstName() const { return string(firstName()); }
+        string getFullName() const { return getLastName().append(middleName()).append(firstName()); }
+        string getPhoneNumber() const { return string(phoneNumber()); }
+        string getDisplayString() const {
+            string text = getFullName() + " - " + getPhoneNumber() + "\n";
+            return text.append(snapshot->text(record->streetNum)).append(" ").append(snapshot->text(record->street)).append(", ")
+                    .append(snapshot->text(record->city)).append(", ").append(snapshot->text(record->state)).append(" ")
+                    .append(snapshot->text(record->zip));
+        }
+        // A live copy, e.g. to load the snapshot back into a PhoneDirectory that will be changed
+        PhoneEntry toPhoneEntry() const {
+            const Record& r = *record;
+            return PhoneEntry(snapshot->text(r.first), snapshot->text(r.middle), snapshot->text(r.last), snapshot->text(r.streetNum),
+                              snapshot->text(r.street), snapshot->text(r.city), snapshot->text(r.state), snapshot->text(r.zip),
+                              snapshot->text(r.number));
+        }
     };
+
+    // The entries a lookup found, a view over the postings in the file
+    class Range {
+    private:
+        const DirectorySnapshot* snapshot;
+        const uint32_t* first;
+        const uint32_t* last;
+    public:
+        class iterator {
+        private:
+            const DirectorySnapshot* snapshot;
+            const uint32_t* position;
+        public:
+            iterator(const DirectorySnapshot* owner, const uint32_t* at) : snapshot(owner), position(at) {}
+            EntryView operator*() const { return snapshot->entry(*position); }
+            iterator& operator++() { ++position; return *this; }
+            bool operator!=(const iterator& other) const { return position != other.position; }
+            bool operator==(const iterator& other) const { return position == other.position; }
+        };
+        Range() : snapshot(nullptr), first(nullptr), last(nullptr) {}
+        Range(const DirectorySnapshot* owner, const uint32_t* begin, const uint32_t* end) : snapshot(owner), first(begin), last(end) {}
+        iterator begin() const { return iterator(snapshot, first); }
+        iterator end() const { return iterator(snapshot, last); }
+        size_t size() const { return size_t(last - first); }
+        bool empty() const { return first == last; }
+    };
+
     /**
-     * Delete function - Deleting a PhoneEntry object from the dictionary based on the person's full name
-     * @param fullName - Represents the full name of the person to be removed
+     * Maps a snapshot written by write(), checking the header before anything else is read and that every section
+     * it points to is inside the file. What is inside the sections (string offsets and numbers, postings, slots) is
+     * checked when it is read, a damaged one throws runtime_error rather than being read out of bounds
+     * @param path - The snapshot file
      */
-    void remove(const string &fullName) {
-        int bucketIndex = hash(fullName);
-        auto &bucket = buckets[bucketIndex];
-        auto info = find_if(bucket.begin(), bucket.end(), [&fullName](PhoneEntry ex) {
-            return ex.getFullName() == fullName;
-        });
-        if (info != bucket.end()) {
-            bucket.erase(info);
+    explicit DirectorySnapshot(const string& path) : file(path, false) {
+        string_view bytes = file.contents();
+        if (bytes.size() < sizeof(Header)) {
+            throw runtime_error(path + " is not a directory snapshot");
+        }
+        memcpy(&header, bytes.data(), sizeof(Header));
+        if (memcmp(header.magic, magicBytes, sizeof(magicBytes)) != 0) {
+            throw runtime_error(path + " is not a directory snapshot");
+        }
+        if (header.byteOrder != byteOrderMark) {
+            throw runtime_error(path + " was written on a machine with a different byte order");
+        }
+        if (header.version != currentVersion) {
+            throw runtime_error(path + " is snapshot version " + to_string(header.version) + ", expected " + to_string(currentVersion));
+        }
+        if (header.fileSize != bytes.size()) {
+            throw runtime_error(path + " is truncated");
+        }
+        if (header.stringCount >= header.fileSize) {
+            throw runtime_error(path + " is corrupt, its string offsets are out of bounds");
+        }
+        checkSection<uint64_t>(path, "string offsets", header.stringOffsetsOffset, header.stringCount + 1);
+        checkSection<char>(path, "string bytes", header.stringBytesOffset, at<uint64_t>(header.stringOffsetsOffset)[header.stringCount]);
+        checkSection<Record>(path, "entries", header.entriesOffset, header.entryCount);
+        const char* indexNames[indexKinds] = {"last name slots", "first name slots", "full name slots", "phone slots"};
+        for (int kind = 0; kind < indexKinds; kind++) {
+            const IndexSection& section = header.indexes[kind];
+            // Probing masks with slotCount - 1
+            if (section.slotCount == 0 || (section.slotCount & (section.slotCount - 1)) != 0) {
+                throw runtime_error(path + " is corrupt, its " + indexNames[kind] + " are not a power of two");
+            }
+            checkSection<Slot>(path, indexNames[kind], section.slotsOffset, section.slotCount);
+            checkSection<uint32_t>(path, "postings", section.postingsOffset, section.postingCount);
+        }
+        hasher = StringHasher(header.hashSeed);
+        stringOffsets = at<uint64_t>(header.stringOffsetsOffset);
+        stringBytesSize = stringOffsets[header.stringCount];
+        stringBytes = at<char>(header.stringBytesOffset);
+        records = at<Record>(header.entriesOffset);
+        for (int kind = 0; kind < indexKinds; kind++) {
+            slots[kind] = at<Slot>(header.indexes[kind].slotsOffset);
+            postings[kind] = at<uint32_t>(header.indexes[kind].postingsOffset);
         }
     }
 
+    DirectorySnapshot(const DirectorySnapshot&) = delete;
+    DirectorySnapshot& operator=(const DirectorySnapshot&) = delete;
+
     /**
-     * Fetch Methods
-     * Different types of ways to fetch or search for a persons name
+     * Saves the entries of a directory as a snapshot. Only the strings the entries use are written, renumbered from 0.
+     * @param directory - The directory to save, for a Dictionary and ReverseDictionary pair their shared getDirectory()
+     * @param path - Where to write it, replaced if it exists
+     * @param hashPolicy - Hash for the name indexes, its seed is saved so readers hash the same way
      */
-    list<PhoneEntry> fetchByLastName(const string &lastName) {
-        int bucketIndex = hash(lastName);
-        const auto &bucket = buckets[bucketIndex];
+    static void write(const PhoneDirectory& directory, const string& path, StringHasher hashPolicy = StringHasher()) {
+        StringPool& pool = componentPool();
+        vector<uint32_t> renumbered(pool.size(), UINT32_MAX);
+        vector<string_view> strings;
+        auto number = [&](Symbol symbol) {
+            if (renumbered[symbol] == UINT32_MAX) {
+                renumbered[symbol] = uint32_t(strings.size());
+                strings.push_back(pool.view(symbol));
+            }
+            return renumbered[symbol];
+        };
+        vector<Record> entries;
+        entries.reserve(directory.size());
+        directory.entries().forEach([&](EntryId, const PhoneEntry& entry) {
+            const Name& name = entry.getName();
+            const Address& address = entry.getAddress();
+            const PhoneNumber& phone = entry.getPhone();
+            Record record{};
+            record.first = number(name.getFirstNameSymbol());
+            record.middle = number(name.getMiddleNameSymbol());
+            record.last = number(name.getLastNameSymbol());
+            record.streetNum = number(address.getStreetNum().getSymbol());
+            record.street = number(address.getStreetName().getSymbol());
+            record.city = number(address.getCity().getSymbol());
+            record.state = number(address.getState().getSymbol());
+            record.zip = number(address.getZip().getSymbol());
+            record.country = number(phone.getCountryCode().getSymbol());
+            record.area = number(phone.getAreaCode().getSymbol());
+            record.number = number(phone.getSymbol());
+            bool packed = (phone.getKey() & phoneKeySymbolFlag) == 0;
+            record.phoneKey = phoneSlotKey(phone.getKey(), packed, hashPolicy, strings[record.number]);
+            entries.push_back(record);
+        });
 
-        list<PhoneEntry> results;
-        for (PhoneEntry entry: bucket) {
-            if (entry.getLastName() == lastName) {
-                results.push_back(entry);
+        Header header{};
+        memcpy(header.magic, magicBytes, sizeof(magicBytes));
+        header.version = currentVersion;
+        header.byteOrder = byteOrderMark;
+        header.hashSeed = hashPolicy.getSeed();
+        header.stringCount = strings.size();
+        header.entryCount = entries.size();
+
+        vector<char> out(sizeof(Header));
+        auto append = [&out](const void* data, size_t bytes) {
+            out.resize((out.size() + 7) & ~size_t(7));
+            uint64_t offset = out.size();
+            out.insert(out.end(), static_cast<const char*>(data), static_cast<const char*>(data) + bytes);
+            return offset;
+        };
+
+        vector<uint64_t> offsets{0};
+        for (string_view text : strings) offsets.push_back(offsets.back() + text.size());
+        header.stringOffsetsOffset = append(offsets.data(), offsets.size() * sizeof(uint64_t));
+        header.stringBytesOffset = append(nullptr, 0);
+        for (string_view text : strings) out.insert(out.end(), text.begin(), text.end());
+        header.entriesOffset = append(entries.data(), entries.size() * sizeof(Record));
+
+        // Each index: sort the entries by key so equal keys sit together, then give every key one slot
+        for (int kind = 0; kind < indexKinds; kind++) {
+            auto keyText = [&](const Record& record) -> string {
+                switch (kind) {
+                    case LastNameIndex: return string(strings[record.last]);
+                    case FirstNameIndex: return string(strings[record.first]);
+                    case FullNameIndex: return string(strings[record.last]).append(strings[record.middle]).append(strings[record.first]);
+                    default: return string();
+                }
+            };
+            vector<pair<uint64_t, uint32_t>> keyed; // (key, entry number)
+            vector<string> texts(kind == PhoneIndex ? 0 : entries.size());
+            for (uint32_t i = 0; i < entries.size(); i++) {
+                if (kind == PhoneIndex) {
+                    keyed.emplace_back(entries[i].phoneKey, i);
+                } else {
+                    texts[i] = keyText(entries[i]);
+                    keyed.emplace_back(hashPolicy(texts[i]), i);
+                }
+            }
+            sort(keyed.begin(), keyed.end(), [&](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b) {
+                if (a.first != b.first) return a.first < b.first;
+                if (kind != PhoneIndex && texts[a.second] != texts[b.second]) return texts[a.second] < texts[b.second];
+                return a.second < b.second;
+            });
+
+            vector<uint32_t> postingList;
+            vector<Slot> groups;
+            for (size_t i = 0; i < keyed.size(); i++) {
+                bool sameKey = i > 0 && keyed[i].first == keyed[i - 1].first
+                               && (kind == PhoneIndex || texts[keyed[i].second] == texts[keyed[i - 1].second]);
+                if (!sameKey) groups.push_back(Slot{keyed[i].first, uint32_t(postingList.size()), 0});
+                groups.back().count++;
+                postingList.push_back(keyed[i].second);
             }
+            size_t slotCount = 1;
+            while (slotCount < groups.size() * 2) slotCount *= 2;
+            vector<Slot> table(slotCount, Slot{0, 0, 0});
+            for (const Slot& group : groups) {
+                uint64_t position = (kind == PhoneIndex ? hashPolicy(group.key) : group.key) & (slotCount - 1);
+                while (table[position].count != 0) position = (position + 1) & (slotCount - 1);
+                table[position] = group;
+            }
+            IndexSection& section = header.indexes[kind];
+            section.slotCount = slotCount;
+            section.slotsOffset = append(table.data(), table.size() * sizeof(Slot));
+            section.postingCount = postingList.size();
+            section.postingsOffset = append(postingList.data(), postingList.size() * sizeof(uint32_t));
+        }
+        out.resize((out.size() + 7) & ~size_t(7));
+        header.fileSize = out.size();
+        memcpy(out.data(), &header, sizeof(Header));
+
+        ofstream snapshot(path, ios::binary | ios::trunc);
+        snapshot.write(out.data(), streamsize(out.size()));
+        if (!snapshot) {
+            throw runtime_error("Failed to write " + path);
         }
-        return results;
     }
-    list<PhoneEntry> fetchByFirstName(const string& firstName) {
-        int bucketIndex = hash(firstName);
-        const auto& bucket = buckets[bucketIndex];
 
-        list<PhoneEntry> results;
-        for (const auto& entry : bucket) {
-            if (entry.getFirstName() == firstName) {
-                results.push_back(entry);
+    size_t size() const { return header.entryCount; }
+    uint32_t version() const { return header.version; }
+    string_view text(uint32_t number) const {
+        if (number >= header.stringCount || stringOffsets[number] > stringOffsets[number + 1]
+            || stringOffsets[number + 1] > stringBytesSize) {
+            throw runtime_error("Directory snapshot is corrupt, bad string " + to_string(number));
+        }
+        return string_view(stringBytes + stringOffsets[number], stringOffsets[number + 1] - stringOffsets[number]);
+    }
+    EntryView entry(size_t number) const {
+        if (number >= header.entryCount) {
+            throw runtime_error("Directory snapshot is corrupt, bad entry " + to_string(number));
+        }
+        return EntryView(this, records + number);
+    }
+
+    // Lookups, the same keys the PhoneDirectory finds take
+    Range findByLastName(string_view lastName) const {
+        return probe(LastNameIndex, hasher(lastName), [&](const Record& record) { return text(record.last) == lastName; });
+    }
+    Range findByFirstName(string_view firstName) const {
+        return probe(FirstNameIndex, hasher(firstName), [&](const Record& record) { return text(record.first) == firstName; });
+    }
+    Range findByFullName(string_view fullName) const {
+        return probe(FullNameIndex, hasher(fullName), [&](const Record& record) {
+            string_view last = text(record.last), middle = text(record.middle), first = text(record.first);
+            return fullName.size() == last.size() + middle.size() + first.size() && fullName.substr(0, last.size()) == last
+                   && fullName.substr(last.size(), middle.size()) == middle && fullName.substr(last.size() + middle.size()) == first;
+        });
+    }
+    Range findByPhoneNumber(string_view phoneNumber) const {
+        optional<PhoneKey> packed = packPhoneNumber(phoneNumber);
+        uint64_t key = phoneSlotKey(packed.value_or(0), packed.has_value(), hasher, phoneNumber);
+        return probe(PhoneIndex, key, [&](const Record& record) { return packed || text(record.number) == phoneNumber; });
+    }
+
+private:
+    // Linear probing from the key's home slot, matches is only asked about the first entry of a slot with the same key.
+    // At most slotCount slots are read, a damaged table with no empty slot ends the probe instead of looping
+    template <typename Matches>
+    Range probe(int kind, uint64_t key, Matches matches) const {
+        const IndexSection& section = header.indexes[kind];
+        uint64_t mask = section.slotCount - 1;
+        uint64_t position = (kind == PhoneIndex ? hasher(key) : key) & mask;
+        for (uint64_t step = 0; step < section.slotCount; step++, position = (position + 1) & mask) {
+            const Slot& slot = slots[kind][position];
+            if (slot.count == 0) {
+                break;
+            }
+            if (uint64_t(slot.firstPosting) + slot.count > section.postingCount) {
+                throw runtime_error("Directory snapshot is corrupt, bad slot " + to_string(position));
+            }
+            const uint32_t* first = postings[kind] + slot.firstPosting;
+            if (slot.key == key && matches(*entry(*first).getRecord())) {
+                return Range(this, first, first + slot.count);
             }
         }
-        return results;
+        return Range();
     }
-    list<PhoneEntry> fetchByFullName(const string& fullName) {
-        int bucketIndex = hash(fullName);
-        const auto& bucket = buckets[bucketIndex];
+};
 
-        list<PhoneEntry> results;
-        for (PhoneEntry entry : bucket) {
-            if (entry.getFullName() == fullName) {
-                results.push_back(entry);
+/**
+ * @class EpochManager
+ * @details Epoch based reclamation for the concurrent dictionaries. A reader announces the current epoch while it is
+ * looking at shared memory. A writer that unlinks a node or table retires it with the epoch it was unlinked in, and it
+ * is only deleted once every reader that was active at that point has left. Readers never wait on anything.
+ */
+class EpochManager {
+private:
+    static constexpr size_t maxThreads = 256;
+    static constexpr size_t reclaimEvery = 64;
+
+    struct Retired {
+        uint64_t epoch;
+        void* pointer;
+        void (*destroy)(void*);
+    };
+
+    // One cache line per thread so announcing an epoch does not bounce other readers' lines. Only the thread that
+    // claimed the slot touches depth and retired
+    struct alignas(64) ThreadSlot {
+        atomic<uint64_t> epoch{0}; // 0 when the thread is not reading
+        atomic<bool> claimed{false};
+        uint32_t depth = 0;        // Guards the thread has open, only the outermost one announces
+        vector<Retired> retired;   // Retired by this thread and not yet handed to the manager
+    };
+
+    // The slot a thread holds in one manager
+    struct Claim {
+        uint64_t managerId;
+        EpochManager* manager;
+        ThreadSlot* slot;
+    };
+    // Every slot the thread holds, handed back when the thread exits
+    struct ThreadClaims {
+        vector<Claim> claims;
+        ~ThreadClaims() {
+            lock_guard<mutex> guard(registryLock());
+            for (Claim& claim : claims) {
+                if (liveManagers().count(claim.managerId)) claim.manager->release(*claim.slot);
             }
         }
-        return results;
+    };
+
+    // Managers that are still alive, so a thread that exits after its manager is gone leaves it alone. Ids are never
+    // reused, so a new manager at the address of a dead one is not mistaken for it
+    static mutex& registryLock() {
+        static mutex lock;
+        return lock;
+    }
+    static unordered_set<uint64_t>& liveManagers() {
+        static unordered_set<uint64_t> managers;
+        return managers;
+    }
+    static uint64_t nextId() {
+        static atomic<uint64_t> lastId{0};
+        return lastId.fetch_add(1) + 1;
     }
 
-    // getDisplayString method shows the list of entries for each of the 8 buckets
-    void getDisplayString() const {
-        for (int i = 0; i < bucketNum; ++i) {
-            cout << "Bucket " << i << ":" << endl;
-            for (PhoneEntry entry : buckets[i]) {
-                cout << entry.getDisplayString() << endl;
+    const uint64_t id;
+    atomic<uint64_t> globalEpoch{1};
+    ThreadSlot slots[maxThreads];
+    mutex retireLock;
+    vector<Retired> retired;
+
+    // Gives each thread its slot in this manager the first time it reads or retires
+    ThreadSlot& threadSlot() {
+        thread_local ThreadClaims local;
+        for (Claim& claim : local.claims) {
+            if (claim.managerId == id) return *claim.slot;
+        }
+        for (ThreadSlot& slot : slots) {
+            bool expected = false;
+            if (slot.claimed.compare_exchange_strong(expected, true)) {
+                lock_guard<mutex> guard(registryLock());
+                // Drop the claims of managers that are gone while here
+                local.claims.erase(remove_if(local.claims.begin(), local.claims.end(), [](const Claim& claim) {
+                    return liveManagers().count(claim.managerId) == 0;
+                }), local.claims.end());
+                local.claims.push_back({id, this, &slot});
+                return slot;
+            }
+        }
+        throw runtime_error("EpochManager is out of thread slots");
+    }
+
+    // Hands a thread's slot back when it exits, its retired list joins the shared one first
+    void release(ThreadSlot& slot) {
+        {
+            lock_guard<mutex> guard(retireLock);
+            retired.insert(retired.end(), slot.retired.begin(), slot.retired.end());
+            slot.retired.clear();
+            reclaim();
+        }
+        slot.depth = 0;
+        slot.claimed.store(false, memory_order_release);
+    }
+
+    // Deletes what no reader can still see, retireLock must be held
+    void reclaim() {
+        uint64_t oldestActive = globalEpoch.load();
+        for (ThreadSlot& slot : slots) {
+            uint64_t epoch = slot.epoch.load();
+            if (epoch != 0 && epoch < oldestActive) oldestActive = epoch;
+        }
+        auto firstKept = partition(retired.begin(), retired.end(), [oldestActive](const Retired& item) {
+            return item.epoch >= oldestActive;
+        });
+        for (auto item = firstKept; item != retired.end(); ++item) {
+            item->destroy(item->pointer);
+        }
+        retired.erase(firstKept, retired.end());
+    }
+
+public:
+    EpochManager() : id(nextId()) {
+        lock_guard<mutex> guard(registryLock());
+        liveManagers().insert(id);
+    }
+    // No thread may be reading or retiring any more
+    ~EpochManager() {
+        {
+            lock_guard<mutex> guard(registryLock());
+            liveManagers().erase(id);
+        }
+        for (Retired& item : retired) item.destroy(item.pointer);
+        for (ThreadSlot& slot : slots) {
+            for (Retired& item : slot.retired) item.destroy(item.pointer);
+        }
+    }
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // Keeps everything reachable at construction alive until it goes out of scope, guards on one thread can nest
+    class Guard {
+    private:
+        ThreadSlot& slot;
+    public:
+        explicit Guard(EpochManager& manager) : slot(manager.threadSlot()) {
+            if (slot.depth++ == 0) {
+                slot.epoch.store(manager.globalEpoch.load());
+                atomic_thread_fence(memory_order_seq_cst);
             }
         }
+        ~Guard() {
+            if (--slot.depth == 0) slot.epoch.store(0, memory_order_release);
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    // Deletes pointer once no reader can be looking at it, call after it has been unlinked. It goes on the calling
+    // thread's own list, which is merged into the shared one under the lock every reclaimEvery retires
+    template <typename T>
+    void retire(T* pointer) {
+        ThreadSlot& slot = threadSlot();
+        slot.retired.push_back({globalEpoch.fetch_add(1), pointer, [](void* item) { delete static_cast<T*>(item); }});
+        if (slot.retired.size() >= reclaimEvery) {
+            lock_guard<mutex> guard(retireLock);
+            retired.insert(retired.end(), slot.retired.begin(), slot.retired.end());
+            slot.retired.clear();
+            reclaim();
+        }
     }
 };
 
-// Essentially the opposite of the Dictionary class but has a lot of similarities
-class ReverseDictionary {
+/**
+ * @class ConcurrentDictionary
+ * @details A PhoneEntry table for services that do many lookups from many threads and the odd insert or remove.
+ * The entries are split over shardCount shards by hash, every shard is a linear probing table of atomic pointers to
+ * immutable nodes.
+ *  - Lookups take no locks at all. They enter an epoch, load the shard's table and probe it, a slot is either empty,
+ *    a tombstone or a node that is never changed after it is published.
+ *  - Writers lock only the shard the key hashes to. A remove swaps the slot to a tombstone, a resize builds a new
+ *    table and publishes it with one store, and the old node or table is retired to the EpochManager.
+ * So lookups on different cores only share read-only cache lines and keep going while writers work on any shard.
+ * @tparam KeyOf - Which key it is indexed by, FullNameKey or PhoneNumberKey
+ */
+template <typename KeyOf>
+class ConcurrentDictionary {
 private:
-    static const int bucketNum = 8; // Adjust the number of buckets as needed
-    list<PhoneEntry> buckets[bucketNum]; // Use an array of lists
+    static constexpr size_t shardCount = 64;
+
+    struct Node {
+        uint64_t hash;
+        PhoneEntry entry;
+    };
+
+    struct Table {
+        size_t mask;
+        size_t used = 0; // nodes and tombstones
+        unique_ptr<atomic<Node*>[]> slots;
+
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new atomic<Node*>[capacity]()) {}
+    };
+
+    struct alignas(64) Shard {
+        mutex writeLock;
+        atomic<Table*> table{nullptr};
+        atomic<size_t> count{0};
+    };
+
+    Shard shards[shardCount];
+    StringHasher hasher;
+    // This dictionary's own epochs, what it retired is deleted with it at the latest
+    mutable EpochManager epochs;
+
+    static Node* tombstone() { return reinterpret_cast<Node*>(uintptr_t(1)); }
+
+    Shard& shardFor(uint64_t hash) { return shards[hash >> 58]; }
+    const Shard& shardFor(uint64_t hash) const { return shards[hash >> 58]; }
+
+    // Puts node in the first free slot of a table no reader can see yet
+    static void placeUnpublished(Table& table, Node* node) {
+        size_t index = node->hash & table.mask;
+        while (table.slots[index].load(memory_order_relaxed) != nullptr) {
+            index = (index + 1) & table.mask;
+        }
+        table.slots[index].store(node, memory_order_relaxed);
+        table.used++;
+    }
+
+    // Copies the live nodes into a new table sized for them, then swaps it in, the shard lock must be held
+    void resize(Shard& shard) {
+        Table* old = shard.table.load(memory_order_relaxed);
+        size_t capacity = 16;
+        while (capacity < (shard.count.load(memory_order_relaxed) + 1) * 4) capacity *= 2;
 
-    // An unsigned integer representing the number of buckets
-    unsigned int hashPhoneNumber(const string& phoneNumber) const {
-        // Calculate a hash value based on the ASCII values of the phone number digits
-        unsigned int hashValue = 0;
-        for (char value : phoneNumber) {
-            hashValue += (value);
+        Table* replacement = new Table(capacity);
+        if (old != nullptr) {
+            for (size_t i = 0; i <= old->mask; i++) {
+                Node* node = old->slots[i].load(memory_order_relaxed);
+                if (node != nullptr && node != tombstone()) placeUnpublished(*replacement, node);
+            }
         }
-        // Use modulo division to map the hash value to a bucket index
-        return hashValue % bucketNum;
+        shard.table.store(replacement, memory_order_release);
+        if (old != nullptr) epochs.retire(old);
     }
 
 public:
-    // Similar to the Dictionary class's insert, search, and display
+    explicit ConcurrentDictionary(StringHasher hashPolicy = StringHasher()) : hasher(hashPolicy) {}
+    ~ConcurrentDictionary() {
+        for (Shard& shard : shards) {
+            Table* table = shard.table.load();
+            if (table == nullptr) continue;
+            for (size_t i = 0; i <= table->mask; i++) {
+                Node* node = table->slots[i].load();
+                if (node != nullptr && node != tombstone()) delete node;
+            }
+            delete table;
+        }
+    }
+
+    ConcurrentDictionary(const ConcurrentDictionary&) = delete;
+    ConcurrentDictionary& operator=(const ConcurrentDictionary&) = delete;
+
     void insert(PhoneEntry entry) {
-        // Hash the phone number and insert the entry into the corresponding bucket
-        int bucketIndex = hashPhoneNumber(entry.getPhoneNumber());
-        buckets[bucketIndex].push_back(entry);
+        uint64_t hashValue = hasher(KeyOf::key(entry));
+        Node* node = new Node{hashValue, std::move(entry)};
+        Shard& shard = shardFor(hashValue);
+
+        lock_guard<mutex> guard(shard.writeLock);
+        Table* table = shard.table.load(memory_order_relaxed);
+        if (table == nullptr || (table->used + 1) * 2 > table->mask + 1) {
+            resize(shard);
+            table = shard.table.load(memory_order_relaxed);
+        }
+        size_t index = hashValue & table->mask;
+        while (true) {
+            Node* current = table->slots[index].load(memory_order_relaxed);
+            if (current == nullptr) {
+                table->used++;
+                break;
+            }
+            // Readers skip tombstones, so one can be reused without breaking their probe
+            if (current == tombstone()) break;
+            index = (index + 1) & table->mask;
+        }
+        table->slots[index].store(node, memory_order_release);
+        shard.count.fetch_add(1, memory_order_relaxed);
     }
 
-    // Search for phone entries by phone number
-    list<PhoneEntry> searchByPhoneNumber(const string& phoneNumber) const {
-        int bucketIndex = hashPhoneNumber(phoneNumber);
-        const auto& bucket = buckets[bucketIndex];
+    // Removes the first entry with this key, returns false if there was none
+    bool remove(string_view key) {
+        uint64_t hashValue = hasher(key);
+        Shard& shard = shardFor(hashValue);
 
-        list<PhoneEntry> results;
-        for (PhoneEntry entry : bucket) {
-            if (entry.getPhoneNumber() == phoneNumber) {
-                results.push_back(entry);
+        lock_guard<mutex> guard(shard.writeLock);
+        Table* table = shard.table.load(memory_order_relaxed);
+        if (table == nullptr) return false;
+        for (size_t index = hashValue & table->mask;; index = (index + 1) & table->mask) {
+            Node* node = table->slots[index].load(memory_order_relaxed);
+            if (node == nullptr) return false;
+            if (node != tombstone() && node->hash == hashValue && KeyOf::matches(node->entry, key)) {
+                table->slots[index].store(tombstone(), memory_order_release);
+                shard.count.fetch_sub(1, memory_order_relaxed);
+                epochs.retire(node);
+                return true;
             }
         }
-        return results;
     }
 
-    // Display reverse phone directory entries
-    void getDisplayString() const {
-        for (int i = 0; i < bucketNum; ++i) {
-            cout << "Bucket " << i << ":" << endl;
-            for (PhoneEntry entry : buckets[i]) {
-                cout << entry.getDisplayString() << endl;
+    /**
+     * Calls visit(const PhoneEntry&) for every entry with this key, without taking any lock.
+     * The reference is only good inside visit, copy the entry to keep it.
+     */
+    template <typename Visit>
+    void forEachMatch(string_view key, Visit visit) const {
+        uint64_t hashValue = hasher(key);
+        const Shard& shard = shardFor(hashValue);
+
+        EpochManager::Guard guard(epochs);
+        const Table* table = shard.table.load(memory_order_acquire);
+        if (table == nullptr) return;
+        for (size_t index = hashValue & table->mask;; index = (index + 1) & table->mask) {
+            const Node* node = table->slots[index].load(memory_order_acquire);
+            if (node == nullptr) return;
+            if (node != tombstone() && node->hash == hashValue && KeyOf::matches(node->entry, key)) {
+                visit(node->entry);
             }
         }
     }
+
+    // Copies of the entries with this key
+    list<PhoneEntry> fetch(string_view key) const {
+        list<PhoneEntry> results;
+        forEachMatch(key, [&results](const PhoneEntry& entry) { results.push_back(entry); });
+        return results;
+    }
+
+    bool contains(string_view key) const {
+        bool found = false;
+        forEachMatch(key, [&found](const PhoneEntry&) { found = true; });
+        return found;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) total += shard.count.load(memory_order_relaxed);
+        return total;
+    }
 };
 
+// Concurrent versions of Dictionary (by full name) and ReverseDictionary (by phone number)
+using ConcurrentNameDictionary = ConcurrentDictionary<FullNameKey>;
+using ConcurrentReverseDictionary = ConcurrentDictionary<PhoneNumberKey>;
+
 int main() {
 
-    // Create instances of Dictionary and ReverseDictionary
-    Dictionary phoneDictionary;
-    ReverseDictionary reversePhoneDictionary;
+    // Create instances of Dictionary and ReverseDictionary, sharing one directory so each entry is stored once
+    auto directory = make_shared<PhoneDirectory>();
+    Dictionary phoneDictionary(directory);
+    ReverseDictionary reversePhoneDictionary(directory);
 
     // Create and insert PhoneEntry objects into Dictionary
     PhoneEntry entry1("John", "Joe", "Doe", "123", "Main St", "New York", "NY", "10001", "1-123-456-7890");
@@ -435,6 +4210,8 @@ int main() {
 
     phoneDictionary.insert(entry1);
     phoneDictionary.insert(entry2);
+    // Or build the entry in place
+    phoneDictionary.emplace("Carol", "Lynn", "Doe", "12", "Birch St", "Boston", "MA", "02101", "1-617-555-0100");
 
     // Create and insert PhoneEntry objects into ReverseDictionary
     PhoneEntry entry3("Bob", "Dave", "Johnson", "789", "Oak St", "Chicago", "IL", "60601", "3-555-123-4567");
@@ -445,6 +4222,12 @@ int main() {
 
     // Print a message to verify successful insertions
     cout << "Phone entries inserted successfully." << endl;
+    cout << "Interned strings: " << componentPool().size() << ", pool memory: " << componentPool().memoryUsed() << " bytes, "
+         << sizeof(PhoneEntry) << " bytes per entry" << endl;
+    // Names are stored canonicalized, however they were typed
+    PhoneEntry typedName("  jOHN ", "joe", "DOE", "123", "Main St", "New York", "NY", "10001", "1-123-456-7890");
+    cout << "'  jOHN ', 'joe', 'DOE' is stored as " << typedName.getFirstName() << " " << typedName.getLastName() << ", "
+         << (typedName.getFullName() == entry1.getFullName() ? "the same name as" : "a different name from") << " entry1" << endl;
 
     // Testing Dictionary
     cout << "Fetching by last name 'Doe':" << endl;
@@ -452,7 +4235,16 @@ int main() {
     for (PhoneEntry entry: entriesByLastName) {
         cout << entry.getDisplayString() << endl;
     }
-    // Print out the buckets
+    // Same lookup without copying anything
+    cout << "Finding by last name 'Doe': " << phoneDictionary.findByLastName("Doe").size() << " entries" << endl;
+    for (const PhoneEntry& entry: phoneDictionary.findByLastName("Doe")) {
+        cout << entry.getFirstName() << endl;
+    }
+    cout << "Fetching by first name 'Alice':" << endl;
+    for (const PhoneEntry& entry: phoneDictionary.fetchByFirstName("Alice")) {
+        cout << entry.getDisplayString() << endl;
+    }
+    // Print out the directory
     //phoneDictionary.getDisplayString();
 
     // Testing ReverseDictionary
@@ -461,9 +4253,218 @@ int main() {
     for (PhoneEntry entry: entriesByPhoneNumber) {
         cout << entry.getDisplayString() << endl;
     }
-    // Print out the buckets
+    // Print out the directory
     //reversePhoneDictionary.getDisplayString();
 
+    // A number with and without its country code, see packPhoneNumber
+    cout << "555-123-4567 packs as " << formatPhoneKey(*packPhoneNumber("555-123-4567")) << ", 1-555-123-4567 as "
+         << formatPhoneKey(*packPhoneNumber("1-555-123-4567")) << endl;
+    bool samePacking = packPhoneNumber("(555) 123-4567") == packPhoneNumber("555-123-4567")
+                       && packPhoneNumber("+1 555 123 4567") == packPhoneNumber("1-555-123-4567")
+                       && packPhoneNumber("+1.555.1234567") == packPhoneNumber("1-555-123-4567");
+    cout << "Other spellings pack the same: " << (samePacking ? "yes" : "no") << ", '+1 (617) 555-0100' finds "
+         << reversePhoneDictionary.findByPhoneNumber("+1 (617) 555-0100").size() << " entry" << endl;
+
+    // Batch reverse lookup, several numbers resolved with one call into a caller's array
+    string_view batchNumbers[] = {"1-123-456-7890", "2-987-654-3210", "9-999-999-9999", "1-617-555-0100"};
+    EntryRange batchResults[4];
+    reversePhoneDictionary.findByPhoneNumbers(batchNumbers, 4, batchResults);
+    for (size_t i = 0; i < 4; i++) {
+        cout << batchNumbers[i] << ": " << (batchResults[i].empty() ? "not found" : batchResults[i].front().getFullName()) << endl;
+    }
+
+    // Hash table statistics of the shared directory, the counters need -DDIRECTORY_STATS
+    cout << "Stats: " << phoneDictionary.getStatsJson() << endl;
+
+    // Scan queries on the columnar copy of the directory
+    phoneDictionary.getDirectory()->enableColumns();
+    cout << "Entries in CA: " << phoneDictionary.getDirectory()->countMatching(ColumnFilter::inState("CA"))
+         << ", with a zip starting 94: " << phoneDictionary.getDirectory()->scan(ColumnFilter::inState("CA").withZipPrefix("94")).size()
+         << ", starting 9x: " << phoneDictionary.getDirectory()->countMatching(ColumnFilter::all().withZipPrefix("9x")) << endl;
+
+    // Freeze the directory once it is complete, lookups then go through minimal perfect hashes
+    FrozenDirectory frozen = reversePhoneDictionary.freeze();
+    cout << "Frozen: " << frozen.findByPhoneNumber("3-555-123-4567").front().getFullName() << " by phone, "
+         << frozen.findByLastName("Doe").size() << " named Doe, " << frozen.findByFirstName("Eve").size() << " named Eve" << endl;
+    // A directory with its own seed freezes with that seed, the lookups must still find the entries
+    Dictionary seededDictionary(StringHasher(12345));
+    seededDictionary.insert(entry1);
+    seededDictionary.insert(entry2);
+    FrozenDirectory seededFrozen = seededDictionary.freeze();
+    cout << "Frozen with a seeded hasher: " << seededFrozen.findByFullName(entry2.getFullName()).size() << " "
+         << entry2.getFullName() << ", " << seededFrozen.findByPhoneNumber("1-123-456-7890").size() << " by phone" << endl;
+    // Built on several threads, the perfect hash must still give each key its own number in [0, n)
+    vector<uint64_t> keyHashes;
+    for (size_t i = 0; i < 100000; i++) keyHashes.push_back(StringHasher()(to_string(i)));
+    MinimalPerfectHash perfect(keyHashes, 4);
+    vector<bool> numberUsed(keyHashes.size(), false);
+    size_t ownNumbers = 0;
+    for (uint64_t keyHash : keyHashes) {
+        size_t number = perfect(keyHash);
+        if (number < keyHashes.size() && !numberUsed[number]) {
+            numberUsed[number] = true;
+            ownNumbers++;
+        }
+    }
+    cout << "Perfect hash on 4 threads: " << ownNumbers << " of " << keyHashes.size() << " keys have their own number, "
+         << perfect.bitsPerKey() << " bits per key" << endl;
+    // A hash given twice counts once and is reported, the frozen indexes compare those keys one by one
+    keyHashes.push_back(keyHashes[7]);
+    MinimalPerfectHash withDuplicate(keyHashes, 4);
+    cout << "Perfect hash with a repeated hash: " << withDuplicate.size() << " numbers, "
+         << withDuplicate.duplicateHashes().size() << " duplicate" << endl;
+
+    // Save the shared directory as a snapshot and answer the same lookup from the mapped file
+    try {
+        DirectorySnapshot::write(*phoneDictionary.getDirectory(), "phonebook.snapshot");
+        DirectorySnapshot snapshot("phonebook.snapshot");
+        cout << "Snapshot v" << snapshot.version() << " with " << snapshot.size() << " entries, by phone number:" << endl;
+        for (DirectorySnapshot::EntryView entry : snapshot.findByPhoneNumber("3-555-123-4567")) {
+            cout << entry.getDisplayString() << endl;
+        }
+        // A copy whose entry table points past the end of the file is refused
+        ifstream original("phonebook.snapshot", ios::binary);
+        string bytes((istreambuf_iterator<char>(original)), istreambuf_iterator<char>());
+        DirectorySnapshot::Header damaged;
+        memcpy(&damaged, bytes.data(), sizeof(damaged));
+        damaged.entriesOffset = damaged.fileSize;
+        memcpy(&bytes[0], &damaged, sizeof(damaged));
+        ofstream("phonebook.damaged", ios::binary).write(bytes.data(), streamsize(bytes.size()));
+        try {
+            DirectorySnapshot refused("phonebook.damaged");
+            cout << "Damaged snapshot was opened" << endl;
+        } catch (const runtime_error& error) {
+            cout << "Damaged snapshot refused: " << error.what() << endl;
+        }
+        remove("phonebook.damaged");
+        remove("phonebook.snapshot");
+    } catch (const runtime_error& error) {
+        cerr << error.what() << endl;
+    }
+
+    // Bulk load the Project 6 people into their own directory
+    try {
+        PhoneDirectory people;
+        CsvLoadResult loaded = loadDirectoryCsv(people, "../Proj6/personRelation.csv");
+        cout << "Loaded " << loaded.rows << " rows (" << loaded.bytes << " bytes) in " << loaded.seconds * 1000 << " ms, "
+             << people.findByLastName("Broussard").size() << " named Broussard" << endl;
+        people.enableNameSearch();
+        cout << "Last names starting with \"bro\":" << endl;
+        for (EntryId id : people.completeLastName("bro", 5)) {
+            cout << "  " << people.get(id).getLastName() << ", " << people.get(id).getFirstName() << endl;
+        }
+        cout << "Sounds like \"Brousard\": " << people.findByLastNameSound("Brousard").size() << " entries, within 2 edits:" << endl;
+        for (EntryId id : people.findByLastNameTypo("brousard", 2, 5)) {
+            cout << "  " << people.get(id).getLastName() << ", " << people.get(id).getFirstName() << endl;
+        }
+        // Removed entries must not come back from the typo search
+        vector<EntryId> removed;
+        EntryRange broussards = people.findByLastName("Broussard");
+        for (auto entry = broussards.begin(); entry != broussards.end(); ++entry) {
+            removed.push_back(entry.id());
+        }
+        for (EntryId id : removed) people.erase(id);
+        size_t stillFound = 0;
+        for (EntryId id : people.findByLastNameTypo("brousard", 2, 1000)) {
+            stillFound += count(removed.begin(), removed.end(), id);
+        }
+        cout << "After removing the " << removed.size() << " Broussards, " << stillFound << " of them within 2 edits of \"brousard\"" << endl;
+    } catch (const runtime_error& error) {
+        cerr << error.what() << endl;
+    }
+
+    // Hash distribution diagnostics, the old ASCII sum against the new hash on the same names
+    const string firstNames[] = {"Ann", "Lee", "John", "Alice", "Bob", "Eve", "Dave", "Joe", "Adam", "Mary"};
+    const string lastNames[] = {"Lee", "Ann", "Doe", "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller"};
+    vector<string> names;
+    for (const string& last : lastNames) {
+        for (const string& middle : firstNames) {
+            for (const string& first : firstNames) {
+                names.push_back(last + middle + first);
+            }
+        }
+    }
+    auto asciiSum = [](string_view key) {
+        uint64_t hashValue = 0;
+        for (char value : key) hashValue += value;
+        return hashValue << 7; // the old hash used the sum directly as the bucket
+    };
+    analyzeHash(names, 64, asciiSum).print("ASCII sum");
+    analyzeHash(names, 64, StringHasher()).print("StringHasher");
+    analyzeHash(names, 64, StringHasher::seeded()).print("StringHasher (seeded)");
+
+    // Concurrent reverse lookups, reader threads keep looking numbers up while a writer inserts and removes
+    ConcurrentReverseDictionary concurrentDictionary;
+    const int preloaded = 100000;
+    for (int i = 0; i < preloaded; i++) {
+        concurrentDictionary.insert(PhoneEntry("First", "M", "Last" + to_string(i % 1000), "1", "Main St", "City", "ST", "00000",
+                                               "1-555-" + to_string(i)));
+    }
+    for (unsigned threadCount = 1; threadCount <= max(1u, thread::hardware_concurrency()); threadCount *= 2) {
+        atomic<bool> stop{false};
+        atomic<long long> lookups{0};
+        vector<thread> readers;
+        for (unsigned t = 0; t < threadCount; t++) {
+            readers.emplace_back([&, t]() {
+                long long done = 0;
+                string key;
+                for (unsigned i = t; !stop.load(memory_order_relaxed); i += 7919) {
+                    key = "1-555-" + to_string(i % preloaded);
+                    concurrentDictionary.contains(key);
+                    done++;
+                }
+                lookups += done;
+            });
+        }
+        thread writer([&]() {
+            for (int i = 0; !stop.load(memory_order_relaxed); i++) {
+                string number = "2-555-" + to_string(i);
+                concurrentDictionary.insert(PhoneEntry("New", "M", "Entry", "1", "Main St", "City", "ST", "00000", number));
+                concurrentDictionary.remove(number);
+            }
+        });
+        this_thread::sleep_for(chrono::milliseconds(200));
+        stop = true;
+        for (thread& reader : readers) reader.join();
+        writer.join();
+        cout << threadCount << " reader thread(s): " << lookups.load() * 5 << " lookups per second" << endl;
+    }
+
+    // A lookup in one dictionary nested inside a lookup in another, while a writer churns both. Each dictionary has its
+    // own epochs, so leaving the inner lookup does not end the outer one's protection
+    ConcurrentNameDictionary concurrentNames;
+    atomic<bool> stopChurn{false}, populated{false};
+    thread churn([&]() {
+        for (int i = 0; !stopChurn.load(memory_order_relaxed); i++) {
+            // Half of the 64 numbers are in the dictionary at any time
+            string number = "3-555-" + to_string(i % 64);
+            concurrentDictionary.insert(PhoneEntry("Churn", "M", "Entry", "1", "Main St", "City", "ST", "00000", number));
+            concurrentNames.insert(PhoneEntry("Churn", "M", "Entry", "1", "Main St", "City", "ST", "00000", number));
+            if (i >= 32) {
+                concurrentDictionary.remove("3-555-" + to_string((i - 32) % 64));
+                concurrentNames.remove("EntryMChurn");
+            }
+            if (i == 32) populated = true;
+        }
+    });
+    // Both dictionaries have entries before the lookups start, otherwise there may be nothing to look at
+    while (!populated.load()) this_thread::yield();
+    size_t nestedLookups = 0, intact = 0;
+    for (int i = 0; i < 20000; i++) {
+        concurrentDictionary.forEachMatch("3-555-" + to_string(i % 64), [&](const PhoneEntry& outer) {
+            concurrentNames.contains(outer.getFullName());
+            // The outer entry is still readable after the inner lookup has finished
+            intact += outer.getFullName() == "EntryMChurn";
+            nestedLookups++;
+        });
+    }
+    stopChurn = true;
+    churn.join();
+    cout << "Nested lookups across two dictionaries: " << intact << " of " << nestedLookups << " intact" << endl;
+    if (nestedLookups == 0 || intact != nestedLookups) {
+        cerr << "Nested lookup check failed" << endl;
+    }
+
     // Testing other functions
     //cout << "Initials:" << "\n" << entry1.getInitials() << "\n";
     //cout << "Phone: " << "\n" << entry2.getPhoneNumber() << "\n";
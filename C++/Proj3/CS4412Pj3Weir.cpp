@@ -1,8 +1,8 @@
 #include <iostream>
-#include <array>
-#include <cmath>
-#include <iomanip>
 #include <chrono>
+#include <random>
+#include <string>
+#include <vector>
 #include "CS4412Pj3Weir.h"
 
 using namespace std;
@@ -13,173 +13,41 @@ using namespace std;
  * @date 10-1-23
  * @details Project 3 - Non-Recursive C++ PriorityQueue
  *  This is based mostly off CS4412/5512 Notes 3.3 Heap or Priority Queue
+ *  The queue itself is in CS4412Pj3Weir.h so Project 4 can use it too
  *
  */
 
-// Define maximum size, probably should change, so it can be dynamic
-const unsigned int MAX_SIZE = 100000;
-
 /**
- * @class nonRecursivePriorityQueue: This class is a Non Recursive Priority Queue that is heavily based off of  Note 3.3
+ * Times count inserts of the given keys followed by count extractions on one queue type
+ * @param keys represents the keys to insert, in the order they are inserted
+ * @return Nanoseconds per insert and extraction pair
  */
-class nonRecursivePriorityQueue{
-private:
-    // Implement as an array
-    std::array<unsigned int, MAX_SIZE> nodes{};
-    // Keep track of the current size of the priority queue
-    int size;
-
-    // Function to get the parent index
-    static int getParentIndex(int index) {
-        return (index / 2);
-    }
-
-    // Function to get the left child index
-    static int getLeftChildIndex(int index) {
-        return (2 * index);
-    }
-
-    // Function to get the right child index
-    static int getRightChildIndex(int index) {
-        return (2 * index + 1);
-    }
-
-    /**
-     * This function essentially bubbles down to maintain min-heap property
-     * @param index represents the location of the value
-     */
-    void bubbleDown(int index) {
-        int leftChildIndex = getLeftChildIndex(index);
-        int rightChildIndex = getRightChildIndex(index);
-
-        int smallestIndex = index;
-
-        // Compare with left child
-        if (leftChildIndex < size && nodes[leftChildIndex] < nodes[smallestIndex]) {
-            smallestIndex = leftChildIndex;
-        }
-
-        // Compare with right child
-        if (rightChildIndex < size && nodes[rightChildIndex] < nodes[smallestIndex]) {
-            smallestIndex = rightChildIndex;
-        }
-
-        // If the smallest element is not the current element, swap them and continue
-        if (smallestIndex != index) {
-            swapNodes(index, smallestIndex);
-            bubbleDown(smallestIndex);
-        }
-    }
-
-    /**
-     * This function is to bubbles up to maintain min-heap property
-     * Also places the node to the right-most leaf
-     * @param index represent the location
-     */
-    void bubbleUp(int index) {
-        int placement = nodes[index];
-        int parentIndex = getParentIndex(index);
-
-        while (index > 0 && placement < nodes[parentIndex]) {
-            swapNodes(index, parentIndex);
-            index = parentIndex;
-            parentIndex = getParentIndex(index);
-        }
-    }
-
-    /**
-     * Function to swap two elements in the array
-     * @param index1 The current node we are on
-     * @param index2 The node we want to switch positions with
-     */
-    void swapNodes(int index1, int index2) {
-        swap(nodes[index1], nodes[index2]);
-    }
-
-public:
-    // Initialize and set size to 0
-    nonRecursivePriorityQueue() : size(0){}
-
-    // Checks if the queue is empty
-    bool checkIfEmpty() const {
-        return size == 0;
-    }
-
-    /**
-     *  Function to extract the minimum element (highest priority)
-     * @return Should return the minimum element of the priority
-     */
-    int extractMin() {
-        if (size == 0) {
-            throw runtime_error("Priority Queue is empty");
-        }
-
-        int min = nodes[0];
-        nodes[0] = nodes[size - 1];
-        size--;
-        bubbleDown(0);
-        return min;
-    }
-
-    /**
-     * Function to insert an element into the priority queue
-     * @param value represents the value which the node will be
-     */
-    void insert(int value) {
-        if (size >= MAX_SIZE) {
-            throw runtime_error("Priority Queue is full");
-        }
-        nodes[size] = value;
-        bubbleUp(size);
-        size++;
+template <typename Queue>
+double timeQueue(const vector<int>& keys) {
+    Queue queue;
+    queue.reserve(keys.size());
+    auto start = chrono::high_resolution_clock::now();
+    for (int key : keys) {
+        queue.insert(key);
     }
-
-    /**
-     * Function to print the priority queue
-     */
-    void toString() {
-        cout << "Priority Queue: ";
-        for (int i = 0; i < size; i++) {
-            cout << nodes[i] << " ";
-        }
-        cout << endl;
+    long long checksum = 0;
+    while (!queue.checkIfEmpty()) {
+        checksum += queue.extractTop().key;
     }
-
-   /**
-    * Function to view the tree structure of the priority queue
-    */
-    void viewTree() {
-        if (checkIfEmpty()) {
-            cout << "Priority Queue is empty." << endl;
-            return;
-        }
-
-        int height = static_cast<int>(log2(size)) + 1;
-        int maxWidth = (1 << height) - 1; // Maximum width of the tree
-
-        int index = 0;
-        int levelWidth = 1;
-        for (int i = 0; i < height; i++) {
-            int spaceBetweenNodes = maxWidth / levelWidth;
-
-            for (int j = 0; j < levelWidth; j++) {
-                // Print the element
-                cout << setw(spaceBetweenNodes / 2) << nodes[index + j];
-                // Print spaces between nodes
-                if (j < levelWidth - 1) {
-                    cout << setw(spaceBetweenNodes) << " * ";
-                }
-            }
-            cout << endl;
-
-            index += levelWidth;
-            levelWidth *= 2;
-        }
+    chrono::duration<double, nano> elapsed = chrono::high_resolution_clock::now() - start;
+    // Using the result keeps the extractions from being optimized away
+    if (checksum == -1) {
+        cout << checksum;
     }
-};
+    return elapsed.count() / double(keys.size());
+}
 
-int main() {
-    nonRecursivePriorityQueue priorityQueue;
+/**
+ * Runs the tests, with --benchmark Test 7 goes up to 10^8 elements (about 1 GB and minutes), without it to 10^5
+ */
+int main(int argc, char* argv[]) {
+    bool fullBenchmark = argc > 1 && string(argv[1]) == "--benchmark";
+    nonRecursivePriorityQueue<int> priorityQueue;
 
     // Test 1: Basic Insertion and Extraction
     priorityQueue.toString();
@@ -193,8 +61,8 @@ int main() {
     priorityQueue.viewTree();
 
     // Test to see if extract the minimum element (highest priority)
-    cout << "Extracted Min: " << priorityQueue.extractMin() << endl;
-    cout << "Extracted Min: " << priorityQueue.extractMin() << endl;
+    cout << "Extracted Min: " << priorityQueue.extractTop().key << endl;
+    cout << "Extracted Min: " << priorityQueue.extractTop().key << endl;
 
     //Depending on how much is extracted, size is updated
     size -=2;
@@ -204,27 +72,81 @@ int main() {
 
     // Clear Queue
     for(int p=0; p < size; p++){
-        priorityQueue.extractMin();
+        priorityQueue.extractTop();
     }
 
     // Test 2: Check if empty
     cout << "Is the priority queue empty? " << (priorityQueue.checkIfEmpty() ? "Yes" : "No") << endl;
     priorityQueue.toString();
 
-    // Test 3: Performance Testing
+    // Test 3: Performance Testing, the heap is built from all the elements at once
     const unsigned int numElements = 10000;
-    auto start = chrono::high_resolution_clock::now();
-    for (int i = 0; i < numElements; i++) {
-        priorityQueue.insert(rand() % 100);
+    vector<int> elements(numElements);
+    for (int& element : elements) {
+        element = rand() % 100;
     }
+    auto start = chrono::high_resolution_clock::now();
+    priorityQueue.insertBatch(elements.begin(), elements.end());
     priorityQueue.viewTree();
     for (int i = 0; i < numElements; i++) {
-        priorityQueue.extractMin();
+        priorityQueue.extractTop();
     }
     auto end = chrono::high_resolution_clock::now();
     chrono::duration<double> elapsed = end - start;
     cout << "Time taken for " << numElements << " insertions and extractions: " << elapsed.count() << " seconds" << endl;
 
+    // Test 4: Storage grows with the queue and clear keeps it for reuse
+    nonRecursivePriorityQueue<int> reusedQueue;
+    cout << "Empty queue capacity: " << reusedQueue.getCapacity() << endl;
+    reusedQueue.reserve(numElements);
+    for (int round = 0; round < 3; round++) {
+        for (unsigned int i = 0; i < numElements; i++) {
+            reusedQueue.insert(rand() % 100);
+        }
+        reusedQueue.clear();
+    }
+    cout << "Capacity after three rounds of " << numElements << " inserts: " << reusedQueue.getCapacity() << endl;
+    reusedQueue.shrinkToFit();
+    cout << "Capacity after shrinkToFit: " << reusedQueue.getCapacity() << endl;
+
+    // Test 5: Largest key first, each key carrying a payload
+    nonRecursivePriorityQueue<int, string, MaxFirst> maxQueue;
+    maxQueue.insert(3, "three");
+    maxQueue.insert(7, "seven");
+    maxQueue.insert(5, "five");
+    while (!maxQueue.checkIfEmpty()) {
+        auto top = maxQueue.extractTop();
+        cout << top.key << " " << top.payload << endl;
+    }
+
+    // Test 6: Items that are queued once and moved up with decreaseKey
+    indexedPriorityQueue<int> indexedQueue(5);
+    for (size_t item = 0; item < 5; item++) {
+        indexedQueue.insert(item, 50 - int(item) * 10);
+    }
+    indexedQueue.decreaseKey(0, 5);
+    indexedQueue.erase(4);
+    cout << "Indexed queue holds " << indexedQueue.getSize() << " items, contains 4? " << (indexedQueue.contains(4) ? "Yes" : "No") << endl;
+    while (!indexedQueue.checkIfEmpty()) {
+        auto top = indexedQueue.extractTop();
+        cout << "Item " << top.item << " key " << top.key << endl;
+    }
+
+    // Test 7: Binary heap against 4-ary and 8-ary heaps, sizes 10^3 to 10^5, or 10^5 to 10^8 with --benchmark
+    cout << "Elements    | 2-ary ns/op | 4-ary ns/op | 8-ary ns/op" << endl;
+    mt19937 generator(4412);
+    size_t smallest = fullBenchmark ? 100000 : 1000, largest = fullBenchmark ? 100000000 : 100000;
+    for (size_t count = smallest; count <= largest; count *= 10) {
+        vector<int> keys(count);
+        for (int& key : keys) {
+            key = int(generator() >> 1);
+        }
+        cout << setw(11) << count << " | " << setw(11) << fixed << setprecision(1)
+             << timeQueue<nonRecursivePriorityQueue<int, NoPayload, MinFirst, 2>>(keys) << " | " << setw(11)
+             << timeQueue<nonRecursivePriorityQueue<int, NoPayload, MinFirst, 4>>(keys) << " | " << setw(11)
+             << timeQueue<nonRecursivePriorityQueue<int, NoPayload, MinFirst, 8>>(keys) << endl;
+    }
+
 
     return 0;
 }
@@ -5,5 +5,637 @@
 #ifndef CS4412_HWS_CS4412PJ3WEIR_H
 #define CS4412_HWS_CS4412PJ3WEIR_H
 
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Orders for nonRecursivePriorityQueue. Each one has a static before(a, b) that is true when key a has to come out
+ * before key b, so the comparison is inlined into the bubbling loops. A custom order only needs the same function.
+ */
+// Smallest key first, a min-heap
+struct MinFirst {
+    template <typename Key>
+    static bool before(const Key& a, const Key& b) { return a < b; }
+};
+// Largest key first, a max-heap
+struct MaxFirst {
+    template <typename Key>
+    static bool before(const Key& a, const Key& b) { return b < a; }
+};
+
+// Payload of a queue that only holds keys, it takes no space
+struct NoPayload {};
+
+/**
+ * @class CacheAlignedAllocator
+ * @details Allocator whose arrays start on a cache line, the priority queue's default so its sibling groups line up
+ * with the cache lines
+ * @tparam T - Element type
+ * @tparam Alignment - Byte boundary every array starts on
+ */
+template <typename T, size_t Alignment = 64>
+struct CacheAlignedAllocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = CacheAlignedAllocator<U, Alignment>;
+    };
+
+    CacheAlignedAllocator() = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* pointer, size_t) {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+/**
+ * @class nonRecursivePriorityQueue: This class is a Non Recursive Priority Queue that is heavily based off of  Note 3.3
+ * Every element is a key, which decides the order, and a payload that comes out with it, e.g. a distance and the vertex
+ * it belongs to. The keys and the payloads are kept in two separate arrays so the bubbling loops only read the keys,
+ * a queue with NoPayload never touches its payload array at all.
+ *
+ * With Arity above 2 it is a d-ary heap, each node has Arity children next to each other in the array. The heap is
+ * shallower (log base Arity of n levels) and the children compared at each level of bubbleDown are one group of
+ * Arity keys. The root is stored at index Arity - 1 so every sibling group starts at a multiple of Arity, with the
+ * cache aligned arrays a group of up to 64 bytes (8-ary for 8 byte keys, 16-ary for 4 byte keys) is one cache line.
+ * @tparam Key - What the queue is ordered by
+ * @tparam Payload - What is carried along with each key, NoPayload for a queue of bare keys
+ * @tparam Order - MinFirst, MaxFirst or any struct with the same before()
+ * @tparam Arity - Children per node, 2 for a binary heap
+ * @tparam Allocator - Where the arrays' memory comes from, a caller supplied one decides the alignment itself
+ */
+template <typename Key, typename Payload = NoPayload, typename Order = MinFirst, size_t Arity = 2,
+          typename Allocator = CacheAlignedAllocator<Key>>
+class nonRecursivePriorityQueue{
+public:
+    // One element taken out of the queue
+    struct Entry {
+        Key key;
+        Payload payload;
+    };
+
+private:
+    using KeyAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Key>;
+    using PayloadAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Payload>;
+    static constexpr bool hasPayload = !std::is_empty<Payload>::value;
+    static_assert(Arity >= 2, "A heap node needs at least two children");
+    // Index of the root, the unused slots in front of it line the sibling groups up with multiples of Arity
+    static constexpr size_t rootIndex = Arity - 1;
+
+    // Implement as two arrays that grow, they are empty or hold rootIndex unused slots followed by the elements
+    std::vector<Key, KeyAllocator> keys;
+    std::vector<Payload, PayloadAllocator> payloads;
+
+    // Function to get the parent index
+    static size_t getParentIndex(size_t index) {
+        return index / Arity + Arity - 2;
+    }
+
+    // Function to get the first child index, the rest of the sibling group follows it
+    static size_t getFirstChildIndex(size_t index) {
+        return Arity * (index + 2 - Arity);
+    }
+
+    /**
+     * This function bubbles the element at index down to maintain the heap property. The element is held aside and
+     * each child that comes before it is moved up into the hole, so every step is one move instead of a swap
+     * @param index represents the location of the value
+     */
+    void bubbleDown(size_t index) {
+        size_t size = keys.size();
+        Key placement = std::move(keys[index]);
+        Payload carried = hasPayload ? std::move(payloads[index]) : Payload();
+
+        size_t firstChild;
+        while ((firstChild = getFirstChildIndex(index)) < size) {
+            // Pick the child that comes first, the whole group unless it is the last one in the array
+            size_t childIndex = firstChild;
+            if (firstChild + Arity <= size) {
+                // A full group, a fixed count the compiler can unroll, picking without a branch to mispredict
+                for (size_t sibling = 1; sibling < Arity; sibling++) {
+                    childIndex = Order::before(keys[firstChild + sibling], keys[childIndex]) ? firstChild + sibling : childIndex;
+                }
+            } else {
+                for (size_t sibling = firstChild + 1; sibling < size; sibling++) {
+                    childIndex = Order::before(keys[sibling], keys[childIndex]) ? sibling : childIndex;
+                }
+            }
+            if (!Order::before(keys[childIndex], placement)) {
+                break;
+            }
+            moveNode(childIndex, index);
+            index = childIndex;
+        }
+        keys[index] = std::move(placement);
+        if constexpr (hasPayload) {
+            payloads[index] = std::move(carried);
+        }
+    }
+
+    /**
+     * This function is to bubbles up to maintain the heap property, moving each parent that comes after the element
+     * down into the hole until its place is found
+     * @param index represent the location
+     */
+    void bubbleUp(size_t index) {
+        Key placement = std::move(keys[index]);
+        Payload carried = hasPayload ? std::move(payloads[index]) : Payload();
+
+        while (index > rootIndex) {
+            size_t parentIndex = getParentIndex(index);
+            if (!Order::before(placement, keys[parentIndex])) {
+                break;
+            }
+            moveNode(parentIndex, index);
+            index = parentIndex;
+        }
+        keys[index] = std::move(placement);
+        if constexpr (hasPayload) {
+            payloads[index] = std::move(carried);
+        }
+    }
+
+    /**
+     * Function to move one element to another position in the arrays
+     * @param from The node being moved
+     * @param to The hole it is moved into
+     */
+    void moveNode(size_t from, size_t to) {
+        keys[to] = std::move(keys[from]);
+        if constexpr (hasPayload) {
+            payloads[to] = std::move(payloads[from]);
+        }
+    }
+
+    // Adds the unused slots in front of the root before the first element goes in
+    void padFront() {
+        if (keys.empty()) {
+            keys.resize(rootIndex);
+            if constexpr (hasPayload) {
+                payloads.resize(rootIndex);
+            }
+        }
+    }
+
+    /**
+     * Restores the heap property after elements were appended to the arrays. A few are bubbled up one at a time, a batch
+     * that is large next to the heap is cheaper to rebuild bottom up (Floyd's heapify): every parent from the last one
+     * back to the root is bubbled down, which is linear in the size of the heap and walks the array in order
+     * @param firstNew represents the index of the first appended element
+     */
+    void restoreAfterAppend(size_t firstNew) {
+        size_t added = keys.size() - firstNew;
+        size_t total = getSize();
+        size_t height = 0;
+        for (size_t remaining = total; remaining > 1; remaining /= Arity) {
+            height++;
+        }
+        // Bubbling up costs up to height moves per element, the rebuild about 2 moves per element of the heap
+        if (added * height <= 2 * total) {
+            for (size_t index = firstNew; index < keys.size(); index++) {
+                bubbleUp(index);
+            }
+            return;
+        }
+        for (size_t index = getParentIndex(keys.size() - 1) + 1; index-- > rootIndex;) {
+            bubbleDown(index);
+        }
+    }
+
+public:
+    // Initialize empty, nothing is allocated until the first insert
+    nonRecursivePriorityQueue() = default;
+    // Initialize empty with a caller supplied allocator
+    explicit nonRecursivePriorityQueue(const Allocator& allocator) : keys(KeyAllocator(allocator)), payloads(PayloadAllocator(allocator)) {}
+    /**
+     * Initialize from a range of keys in linear time, see insertBatch
+     * @param first, last represent the keys, each gets a default payload
+     */
+    template <typename Iterator>
+    nonRecursivePriorityQueue(Iterator first, Iterator last) {
+        insertBatch(first, last);
+    }
+
+    // Checks if the queue is empty
+    bool checkIfEmpty() const {
+        return keys.size() <= rootIndex;
+    }
+
+    // Number of elements in the queue
+    size_t getSize() const {
+        return checkIfEmpty() ? 0 : keys.size() - rootIndex;
+    }
+
+    // Number of elements the queue holds before it has to grow
+    size_t getCapacity() const {
+        return keys.capacity() <= rootIndex ? 0 : keys.capacity() - rootIndex;
+    }
+
+    /**
+     * Makes room for at least count elements up front, so a known number of inserts never reallocates
+     * @param count represents how many elements the queue should hold without growing
+     */
+    void reserve(size_t count) {
+        keys.reserve(count + rootIndex);
+        if constexpr (hasPayload) {
+            payloads.reserve(count + rootIndex);
+        }
+    }
+
+    // Gives back the memory the queue is not using
+    void shrinkToFit() {
+        keys.shrink_to_fit();
+        payloads.shrink_to_fit();
+    }
+
+    // Removes every element but keeps the capacity, so the queue can be refilled without allocating
+    void clear() {
+        keys.clear();
+        payloads.clear();
+    }
+
+    // The key that comes out next, the smallest for MinFirst
+    const Key& topKey() const {
+        if (checkIfEmpty()) {
+            throw std::runtime_error("Priority Queue is empty");
+        }
+        return keys[rootIndex];
+    }
+    // The payload that comes out next
+    const Payload& topPayload() const {
+        if (checkIfEmpty()) {
+            throw std::runtime_error("Priority Queue is empty");
+        }
+        return payloads[rootIndex];
+    }
+
+    /**
+     * Function to extract the element that comes first (highest priority)
+     * @return The key and payload of that element
+     */
+    Entry extractTop() {
+        if (checkIfEmpty()) {
+            throw std::runtime_error("Priority Queue is empty");
+        }
+
+        Entry top{std::move(keys[rootIndex]), Payload()};
+        if constexpr (hasPayload) {
+            top.payload = std::move(payloads[rootIndex]);
+            payloads[rootIndex] = std::move(payloads.back());
+            payloads.pop_back();
+        }
+        keys[rootIndex] = std::move(keys.back());
+        keys.pop_back();
+        if (!checkIfEmpty()) {
+            bubbleDown(rootIndex);
+        }
+        return top;
+    }
+
+    /**
+     * Function to insert an element into the priority queue
+     * @param key represents the value the element is ordered by
+     * @param payload represents what comes out with it
+     */
+    void insert(Key key, Payload payload = Payload()) {
+        padFront();
+        keys.push_back(std::move(key));
+        if constexpr (hasPayload) {
+            payloads.push_back(std::move(payload));
+        }
+        bubbleUp(keys.size() - 1);
+    }
+
+    /**
+     * Function to insert many elements at once. They are appended in one go and the heap is fixed up afterwards, which
+     * for a large batch is a linear bottom up rebuild instead of one bubbleUp per element
+     * @param first, last represent the keys, each gets a default payload
+     */
+    template <typename Iterator>
+    void insertBatch(Iterator first, Iterator last) {
+        padFront();
+        size_t firstNew = keys.size();
+        keys.insert(keys.end(), first, last);
+        if constexpr (hasPayload) {
+            payloads.resize(keys.size());
+        }
+        restoreAfterAppend(firstNew);
+    }
+    /**
+     * Function to insert many elements at once, each key with its payload
+     * @param first, last represent the keys
+     * @param payloadFirst represents the payloads, one for each key in the same order
+     */
+    template <typename KeyIterator, typename PayloadIterator>
+    void insertBatch(KeyIterator first, KeyIterator last, PayloadIterator payloadFirst) {
+        padFront();
+        size_t firstNew = keys.size();
+        keys.insert(keys.end(), first, last);
+        if constexpr (hasPayload) {
+            for (size_t index = firstNew; index < keys.size(); index++, ++payloadFirst) {
+                payloads.push_back(*payloadFirst);
+            }
+        }
+        restoreAfterAppend(firstNew);
+    }
+
+    /**
+     * Function to print the keys in the priority queue
+     */
+    void toString() const {
+        std::cout << "Priority Queue: ";
+        for (size_t i = rootIndex; i < keys.size(); i++) {
+            std::cout << keys[i] << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    /**
+     * Function to view the tree structure of the priority queue, as a binary tree so only when Arity is 2
+     */
+    void viewTree() const {
+        static_assert(Arity == 2, "viewTree draws a binary heap");
+        if (checkIfEmpty()) {
+            std::cout << "Priority Queue is empty." << std::endl;
+            return;
+        }
+
+        int height = static_cast<int>(std::log2(getSize())) + 1;
+        int maxWidth = (1 << height) - 1; // Maximum width of the tree
+
+        size_t index = rootIndex;
+        size_t levelWidth = 1;
+        for (int i = 0; i < height; i++) {
+            int spaceBetweenNodes = maxWidth / int(levelWidth);
+
+            // The last level is usually not full
+            for (size_t j = 0; j < levelWidth && index + j < keys.size(); j++) {
+                // Print the element
+                std::cout << std::setw(spaceBetweenNodes / 2) << keys[index + j];
+                // Print spaces between nodes
+                if (j < levelWidth - 1) {
+                    std::cout << std::setw(spaceBetweenNodes) << " * ";
+                }
+            }
+            std::cout << std::endl;
+
+            index += levelWidth;
+            levelWidth *= 2;
+        }
+    }
+};
+
+/**
+ * @class indexedPriorityQueue
+ * @details A priority queue of items numbered 0, 1, 2, ... (e.g. vertex numbers) where each item is in the queue at
+ * most once. A position map remembers where every item sits in the heap, so an item already in the queue can have its
+ * key lowered (decreaseKey) or be taken out (erase) in O(log n) instead of being inserted again.
+ * The heap is laid out like nonRecursivePriorityQueue, root at index Arity - 1 and sibling groups on cache lines.
+ * @tparam Key - What the queue is ordered by
+ * @tparam Order - MinFirst, MaxFirst or any struct with the same before()
+ * @tparam Arity - Children per node, 2 for a binary heap
+ * @tparam Allocator - Where the arrays' memory comes from
+ */
+template <typename Key, typename Order = MinFirst, size_t Arity = 2, typename Allocator = CacheAlignedAllocator<Key>>
+class indexedPriorityQueue{
+public:
+    using Item = size_t;
+
+    // One element taken out of the queue
+    struct Entry {
+        Key key;
+        Item item;
+    };
+
+private:
+    using KeyAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Key>;
+    using ItemAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Item>;
+    static_assert(Arity >= 2, "A heap node needs at least two children");
+    static constexpr size_t rootIndex = Arity - 1;
+    // Position of an item that is not in the queue
+    static constexpr size_t absent = size_t(-1);
+
+    // The heap, keys and the items they belong to in two arrays with rootIndex unused slots at the front
+    std::vector<Key, KeyAllocator> keys;
+    std::vector<Item, ItemAllocator> items;
+    // Where each item is in the heap, absent if it is not in the queue
+    std::vector<size_t, ItemAllocator> positions;
+
+    static size_t getParentIndex(size_t index) {
+        return index / Arity + Arity - 2;
+    }
+    static size_t getFirstChildIndex(size_t index) {
+        return Arity * (index + 2 - Arity);
+    }
+
+    // Puts key and item into slot index and records where the item went
+    void place(size_t index, Key key, Item item) {
+        keys[index] = std::move(key);
+        items[index] = item;
+        positions[item] = index;
+    }
+
+    /**
+     * Bubbles the element at index down to maintain the heap property, children move up into the hole
+     * @param index represents the location of the value
+     */
+    void bubbleDown(size_t index) {
+        size_t size = keys.size();
+        Key placement = std::move(keys[index]);
+        Item item = items[index];
+
+        size_t firstChild;
+        while ((firstChild = getFirstChildIndex(index)) < size) {
+            size_t childIndex = firstChild;
+            size_t lastChild = std::min(firstChild + Arity, size);
+            for (size_t sibling = firstChild + 1; sibling < lastChild; sibling++) {
+                childIndex = Order::before(keys[sibling], keys[childIndex]) ? sibling : childIndex;
+            }
+            if (!Order::before(keys[childIndex], placement)) {
+                break;
+            }
+            place(index, std::move(keys[childIndex]), items[childIndex]);
+            index = childIndex;
+        }
+        place(index, std::move(placement), item);
+    }
+
+    /**
+     * Bubbles the element at index up to maintain the heap property, parents move down into the hole
+     * @param index represent the location
+     */
+    void bubbleUp(size_t index) {
+        Key placement = std::move(keys[index]);
+        Item item = items[index];
+
+        while (index > rootIndex) {
+            size_t parentIndex = getParentIndex(index);
+            if (!Order::before(placement, keys[parentIndex])) {
+                break;
+            }
+            place(index, std::move(keys[parentIndex]), items[parentIndex]);
+            index = parentIndex;
+        }
+        place(index, std::move(placement), item);
+    }
+
+    // Takes the element at index out, the last element fills its slot and is bubbled whichever way it needs to go
+    void removeAt(size_t index) {
+        positions[items[index]] = absent;
+        size_t last = keys.size() - 1;
+        if (index != last) {
+            place(index, std::move(keys[last]), items[last]);
+        }
+        keys.pop_back();
+        items.pop_back();
+        if (index < keys.size()) {
+            if (index > rootIndex && Order::before(keys[index], keys[getParentIndex(index)])) {
+                bubbleUp(index);
+            } else {
+                bubbleDown(index);
+            }
+        }
+    }
+
+public:
+    /**
+     * Initialize empty
+     * @param itemCount represents how many items there are, the queue grows if a larger item is inserted later
+     */
+    explicit indexedPriorityQueue(size_t itemCount = 0, const Allocator& allocator = Allocator())
+            : keys(KeyAllocator(allocator)), items(ItemAllocator(allocator)), positions(itemCount, absent, ItemAllocator(allocator)) {
+        keys.reserve(itemCount + rootIndex);
+        items.reserve(itemCount + rootIndex);
+    }
+
+    // Checks if the queue is empty
+    bool checkIfEmpty() const {
+        return keys.size() <= rootIndex;
+    }
+
+    // Number of items in the queue
+    size_t getSize() const {
+        return checkIfEmpty() ? 0 : keys.size() - rootIndex;
+    }
+
+    // Checks if item is in the queue
+    bool contains(Item item) const {
+        return item < positions.size() && positions[item] != absent;
+    }
+
+    // The key item is queued with
+    const Key& getKey(Item item) const {
+        if (!contains(item)) {
+            throw std::runtime_error("Item is not in the Priority Queue");
+        }
+        return keys[positions[item]];
+    }
+
+    // Removes every item but keeps the capacity
+    void clear() {
+        for (size_t index = rootIndex; index < items.size(); index++) {
+            positions[items[index]] = absent;
+        }
+        keys.clear();
+        items.clear();
+    }
+
+    // The item that comes out next and its key
+    Item topItem() const {
+        if (checkIfEmpty()) {
+            throw std::runtime_error("Priority Queue is empty");
+        }
+        return items[rootIndex];
+    }
+    const Key& topKey() const {
+        if (checkIfEmpty()) {
+            throw std::runtime_error("Priority Queue is empty");
+        }
+        return keys[rootIndex];
+    }
+
+    /**
+     * Function to insert an item into the priority queue
+     * @param item represents the item, it must not be in the queue already
+     * @param key represents the value the item is ordered by
+     */
+    void insert(Item item, Key key) {
+        if (contains(item)) {
+            throw std::runtime_error("Item is already in the Priority Queue");
+        }
+        if (item >= positions.size()) {
+            positions.resize(item + 1, absent);
+        }
+        if (keys.empty()) {
+            keys.resize(rootIndex);
+            items.resize(rootIndex);
+        }
+        keys.push_back(std::move(key));
+        items.push_back(item);
+        positions[item] = keys.size() - 1;
+        bubbleUp(keys.size() - 1);
+    }
+
+    /**
+     * Moves an item forward by giving it a key that comes before its current one, a lower key for MinFirst
+     * @param item represents the item, it must be in the queue
+     * @param key represents its new key
+     */
+    void decreaseKey(Item item, Key key) {
+        if (!contains(item)) {
+            throw std::runtime_error("Item is not in the Priority Queue");
+        }
+        size_t index = positions[item];
+        if (Order::before(keys[index], key)) {
+            throw std::runtime_error("New key would move the item back");
+        }
+        keys[index] = std::move(key);
+        bubbleUp(index);
+    }
+
+    /**
+     * Takes an item out of the queue wherever it is
+     * @param item represents the item
+     * @return false if it was not in the queue
+     */
+    bool erase(Item item) {
+        if (!contains(item)) {
+            return false;
+        }
+        removeAt(positions[item]);
+        return true;
+    }
+
+    /**
+     * Function to extract the item that comes first (highest priority)
+     * @return The key and the item
+     */
+    Entry extractTop() {
+        if (checkIfEmpty()) {
+            throw std::runtime_error("Priority Queue is empty");
+        }
+        Entry top{std::move(keys[rootIndex]), items[rootIndex]};
+        removeAt(rootIndex);
+        return top;
+    }
+};
 
 #endif //CS4412_HWS_CS4412PJ3WEIR_H
@@ -5,7 +5,10 @@
 #include <iomanip>
 #include <algorithm>
 #include <array>
+#include <vector>
+#include <climits>
 #include <fstream>
+#include "../Proj3/CS4412Pj3Weir.h"
 
 using namespace std;
 
@@ -122,140 +125,6 @@ void DisplayVertices2(Vertex vertices[], int columns, const vector<int> &shortes
 }
 
 // Part 2 for the most part
-class CS4412Pj3Weir {
-private:
-    static const unsigned int MAX_SIZE = m;
-    std::array<unsigned int, MAX_SIZE> nodes{};
-    int size;
-
-    int getParentIndex(int index);
-
-    int getLeftChildIndex(int index);
-
-    int getRightChildIndex(int index);
-
-    void bubbleDown(int index);
-
-    void bubbleUp(int index);
-
-    void swapNodes(int index1, int index2);
-
-public:
-    CS4412Pj3Weir() : size(0) {}
-
-    int extractMin();
-
-    void insert(int value);
-
-    bool checkIfEmpty();
-
-    void toString();
-
-    void viewTree();
-};
-
-// Function to get the parent index
-int CS4412Pj3Weir::getParentIndex(int index) {
-    return (index - 1) / 2;
-}
-
-// Function to get the left child index
-int CS4412Pj3Weir::getLeftChildIndex(int index) {
-    return (2 * index + 1);
-}
-
-// Function to get the right child index
-int CS4412Pj3Weir::getRightChildIndex(int index) {
-    return (2 * index + 2);
-}
-
-/**
-	 * This function essentially bubbles down to maintain min-heap property
-	 * @param index represents the location of the value
-	 */
-void CS4412Pj3Weir::bubbleDown(int index) {
-    int leftChildIndex = getLeftChildIndex(index);
-    int rightChildIndex = getRightChildIndex(index);
-
-    int smallestIndex = index;
-
-    // Compare with left child
-    if (leftChildIndex < size && nodes[leftChildIndex] < nodes[smallestIndex]) {
-        smallestIndex = leftChildIndex;
-    }
-
-    // Compare with right child
-    if (rightChildIndex < size && nodes[rightChildIndex] < nodes[smallestIndex]) {
-        smallestIndex = rightChildIndex;
-    }
-
-    // If the smallest element is not the current element, swap them and continue
-    if (smallestIndex != index) {
-        swapNodes(index, smallestIndex);
-        bubbleDown(smallestIndex);
-    }
-}
-
-/**
-	 * This function is to bubbles up to maintain min-heap property
-	 * Also places the node to the right-most leaf
-	 * @param index represent the location
-	 */
-void CS4412Pj3Weir::bubbleUp(int index) {
-    int parentIndex = getParentIndex(index);
-
-    while (index > 0 && nodes[index] < nodes[parentIndex]) {
-        swapNodes(index, parentIndex);
-        index = parentIndex;
-        parentIndex = getParentIndex(index);
-    }
-}
-
-/**
-	 * Function to insert an element into the priority queue
-	 * @param value represents the value which the node will be
-	 */
-void CS4412Pj3Weir::insert(int value) {
-    if (size >= MAX_SIZE) {
-        throw runtime_error("Priority Queue is full");
-    }
-    nodes[size] = value;
-    bubbleUp(size);
-    size++;
-}
-
-/**
-	 *  Function to extract the minimum element (highest priority)
-	 * @return Should return the minimum element of the priority
-	 */
-int CS4412Pj3Weir::extractMin() {
-    if (size == 0) {
-        throw runtime_error("Priority Queue is empty");
-    }
-
-    int min = nodes[0];
-    nodes[0] = nodes[size - 1];
-    size--;
-    bubbleDown(0);
-    return min;
-}
-
-// Checks if the queue is empty
-bool CS4412Pj3Weir::checkIfEmpty() {
-    return size == 0;
-}
-
-/**
-	 * Function to swap two elements in the array
-	 * @param index1 The current node we are on
-	 * @param index2 The node we want to switch positions with
-	 */
-void CS4412Pj3Weir::swapNodes(int index1, int index2) {
-    int temp = nodes[index1];
-    nodes[index1] = nodes[index2];
-    nodes[index2] = temp;
-}
-
 /**
  * Calculates and displays the shortest path from a starting vertex to a target vertex in a graph
  * and uses an adjacency matrix to represent edge weights.
@@ -276,8 +145,8 @@ void shortestPath(int start, int target, Vertex vertices[], int adjacencyMatrix2
         visited2[i] = false;
     }
 
-    // Initialize priority queue
-    CS4412Pj3Weir priorityQueue;
+    // Initialize priority queue of the vertices keyed by distance, each vertex is in it at most once
+    indexedPriorityQueue<int> priorityQueue(m);
 
     // The distance to the starting vertex is 0
     dist[start] = 0;
@@ -285,11 +154,11 @@ void shortestPath(int start, int target, Vertex vertices[], int adjacencyMatrix2
     cout << start << vertices->number << "\n";
 
     // Insert the starting distance into priority queue
-    priorityQueue.insert(start);
+    priorityQueue.insert(start, 0);
 
     while (!priorityQueue.checkIfEmpty()) {
         // Extract the vertex with the smallest distance
-        int u = priorityQueue.extractMin();
+        int u = int(priorityQueue.extractTop().item);
 
         // If the extracted vertex is the target, break the loop
         if (u == target) {
@@ -303,8 +172,12 @@ void shortestPath(int start, int target, Vertex vertices[], int adjacencyMatrix2
                 // If a shorter path is found, update the distance and set the parent
                 dist[v] = dist[u] + adjacencyMatrix2[u][v];
                 vertices[v].parent = &vertices[u];
-                // Insert the vertex with updated distance into the priority queue
-                priorityQueue.insert(v);
+                // Insert the vertex with its distance, or move it up if it is already waiting in the queue
+                if (priorityQueue.contains(v)) {
+                    priorityQueue.decreaseKey(v, dist[v]);
+                } else {
+                    priorityQueue.insert(v, dist[v]);
+                }
             }
         }
 